@@ -70,6 +70,11 @@ typedef enum {
    attr_stribog512,
    attr_growing,
    attr_compressed,
+   attr_merkle,
+   attr_blake3,
+   attr_xxh128,
+   attr_reuse,
+   attr_sampled,
    attr_unknown
 } ATTRIBUTE;
 
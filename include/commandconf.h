@@ -58,6 +58,14 @@ bool do_rootprefix(char*, int, char*, char*);
 
 long do_num_workers(const char *);
 
+long long do_size(const char *);
+
+long long do_rate(const char *);
+
+int do_ioprio(const char *);
+
+device_num_workers *do_device_num_workers(const char *);
+
 #ifdef WITH_E2FSATTRS
 void do_report_ignore_e2fsattrs(char*, int, char*, char*);
 #endif
@@ -53,6 +53,29 @@ typedef enum config_option {
     REPORT_FORMAT_OPTION,
     LIMIT_CMDLINE_OPTION,
     NUM_WORKERS,
+    NUM_SCAN_WORKERS,
+    STATX_DONT_SYNC_OPTION,
+    SCAN_INODE_ORDER_OPTION,
+    HASH_EXTENT_ORDER_OPTION,
+    IO_URING_OPTION,
+    NUM_WORKERS_PER_DEVICE,
+    DEVICE_NUM_WORKERS_OPTION,
+    ONE_FILE_SYSTEM_OPTION,
+    SKIP_PSEUDO_FILESYSTEMS_OPTION,
+    HASH_MMAP_OPTION,
+    HASH_READAHEAD_OPTION,
+    PARALLEL_HASHSUMS_OPTION,
+    XXH128_SHORTCUT_OPTION,
+    MULTI_BUFFER_HASHSUMS_OPTION,
+    MAX_READ_RATE_OPTION,
+    MAX_READ_IOPS_OPTION,
+    MAX_DEVICE_READ_RATE_OPTION,
+    MAX_DEVICE_READ_IOPS_OPTION,
+    WORKER_IOPRIO_OPTION,
+    WORKER_NICE_OPTION,
+    HASH_DIRECT_IO_OPTION,
+    SAMPLED_HASH_SIZE_OPTION,
+    SAMPLED_HASH_WINDOWS_OPTION,
 } config_option;
 
 typedef struct {
@@ -79,6 +79,14 @@
 /*    void* local; */  
 /*  }_db_config ; */
 
+/* limit of num_workers_per_device for a single device */
+typedef struct device_num_workers {
+  char *path; /* NULL if the device is given by major:minor */
+  bool resolved;
+  dev_t dev;
+  long num_workers;
+} device_num_workers;
+
 typedef struct database {
     url_t* url;
 
@@ -155,6 +163,30 @@ typedef struct db_config {
   int action;
 
   long num_workers;
+  long num_scan_workers;
+  long num_workers_per_device;
+  /* list of device_num_workers*s, the first entry for a device is used */
+  list* device_num_workers;
+  bool statx_dont_sync;
+  bool scan_inode_order;
+  bool hash_extent_order;
+  bool io_uring;
+  bool one_file_system;
+  bool skip_pseudo_filesystems;
+  bool hash_mmap;
+  bool hash_readahead;
+  bool parallel_hashsums;
+  bool xxh128_shortcut;
+  bool multi_buffer_hashsums;
+  long long max_read_rate;
+  long long max_read_iops;
+  long long max_device_read_rate;
+  long long max_device_read_iops;
+  int worker_ioprio;
+  int worker_nice;
+  bool hash_direct_io;
+  long long sampled_hash_size;
+  long sampled_hash_windows;
 
   int progress;
   bool no_color;
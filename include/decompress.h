@@ -0,0 +1,52 @@
+/*
+ * AIDE (Advanced Intrusion Detection Environment)
+ *
+ * Copyright (C) 2026 Hannes von Haugwitz
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef _DECOMPRESS_H_INCLUDED
+#define _DECOMPRESS_H_INCLUDED
+
+#include <stddef.h>
+#include <sys/types.h>
+
+/*
+ * streaming decompression of files with the 'compressed' attribute, the
+ * compression algorithm (gzip, zstd, xz, bzip2 or lz4) is detected by the
+ * magic bytes at the start of the file
+ */
+
+typedef struct decompressor decompressor;
+
+/*
+ * decompressor_open()
+ * filedes: file descriptor of fullpath opened for reading (positioned at the
+ * start of the file), compressed_size: size of the compressed file, dev:
+ * device of the file (the compressed reads are accounted by the read rate
+ * limits, see io_limit.h)
+ * returns NULL if the file is not compressed with a supported algorithm or
+ * the decompression could not be started, filedes is left open in this case
+ */
+decompressor *decompressor_open(int filedes, const char *fullpath, off_t compressed_size, dev_t dev);
+
+/* returns the number of decompressed bytes (0 at the end) or -1 on error */
+ssize_t decompressor_read(decompressor *, void *buf, size_t count);
+
+/* frees the decompressor and closes its file descriptor */
+int decompressor_close(decompressor *);
+
+#endif /* _DECOMPRESS_H_INCLUDED */
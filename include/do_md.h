@@ -29,26 +29,69 @@
 #include "md.h"
 
 list* do_md(list* file_lst,db_config* conf);
-md_hashsums calc_hashsums(char*, DB_ATTR_TYPE, struct stat*, ssize_t, bool);
+int open_file_at(int, const char *, int);
+md_hashsums calc_hashsums(int, char*, DB_ATTR_TYPE, struct stat*, ssize_t, bool);
+int hashsum_check_stat(char*, DB_ATTR_TYPE, struct stat*, struct stat*);
+int hashsum_check_size(char*, DB_ATTR_TYPE, struct stat*, ssize_t, off_t);
+void hash_drop_cache(int, const char *, off_t, off_t);
+/* whether calc_hashsums() skips the holes of the (regular) file */
+bool hash_is_sparse(struct stat *);
+
+/*
+ * hash_md_get()
+ * returns an md container of the per thread hash engine ready for
+ * update_md() or NULL on error, the container is reserved until it is
+ * closed by hash_md_close() (which calls close_md())
+ */
+struct md_container *hash_md_get(DB_ATTR_TYPE, const char *);
+void hash_md_close(struct md_container *, md_hashsums *, const char *);
+
+/* files up to this size are hashed by calc_hashsums_multi() */
+#define MULTI_HASH_MAX_SIZE 16384
+
+/* limits of the 'sampled_hash_size' and 'sampled_hash_windows' options */
+#define SAMPLED_HASH_MAX_SIZE 1073741824
+#define SAMPLED_HASH_MAX_WINDOWS 65536
+
+typedef struct multi_hash_file {
+    int dirfd;
+    const char *name;
+    char *fullpath;
+    DB_ATTR_TYPE attr;
+    struct stat *old_fs;
+    /* set by calc_hashsums_multi() */
+    int filedes;
+    md_hashsums md_hash;
+} multi_hash_file;
+
+/*
+ * calc_hashsums_multi()
+ * calculates the hashsums of up to hw_hash_multi_lanes() files, the file
+ * descriptors are left open (filedes is -1 if the file could not be opened)
+ */
+void calc_hashsums_multi(multi_hash_file *, int);
+
+/* the *2line functions use the file descriptor if it is not -1 and fall back
+ * to the full path of the db_line otherwise */
 
 #ifdef WITH_ACL
-void acl2line(db_line* line);
+void acl2line(db_line* line, int filedes);
 #endif
 
 #ifdef WITH_XATTR
-void xattrs2line(db_line *line);
+void xattrs2line(db_line *line, int filedes);
 #endif
 
 #ifdef WITH_SELINUX
-void selinux2line(db_line *line);
+void selinux2line(db_line *line, int filedes);
 #endif
 
 #ifdef WITH_E2FSATTRS
-void e2fsattrs2line(db_line* line);
+void e2fsattrs2line(db_line* line, int filedes);
 #endif
 
 #ifdef WITH_CAPABILITIES
-void capabilities2line(db_line* line);
+void capabilities2line(db_line* line, int filedes);
 #endif
 
 #endif /* _DO_MD_H_INCLUDED */
@@ -28,4 +28,10 @@ unsigned long e2fsattrs_get_flag(char);
 /* memory for the returned string is obtained with malloc(3), and should be freed with free(3). */
 char* get_e2fsattrs_string(unsigned long, bool, unsigned long);
 
+#ifdef HAVE_STATX
+/* returns false if not all e2fs attributes except the ignored ones are
+ * available from the statx() attributes */
+bool get_e2fsattrs_from_statx(unsigned long long, unsigned long long, unsigned long, unsigned long *);
+#endif
+
 #endif
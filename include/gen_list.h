@@ -27,6 +27,7 @@
 #include "rx_rule.h"
 #include "seltree.h"
 struct stat;
+struct md_hashsums;
 
 /* DB_FOO are anded together to form rx_rule's attr */
 
@@ -37,6 +38,13 @@ struct stat;
  */
 void populate_tree(seltree*);
 
+/*
+ * free_old_hashsums_index()
+ * frees the index of old hashsums built by populate_tree() (to be called
+ * after the disk scan has finished)
+ */
+void free_old_hashsums_index(seltree*);
+
 void write_tree(seltree*);
 
 typedef enum match_result {
@@ -51,8 +59,11 @@ typedef enum match_result {
 match_result check_rxtree(char*,seltree*, rx_rule* *, RESTRICTION_TYPE, char *);
 match_result check_limit(char*);
 
-struct db_line* get_file_attrs(char*,DB_ATTR_TYPE, struct stat *);
+struct db_line* get_file_attrs(char*,DB_ATTR_TYPE, struct stat *, int, long, int, struct md_hashsums *);
 void add_file_to_tree(seltree*, db_line*, int, const database *, struct stat *);
 
+/* number of files whose hashsums were reused from database_in ('reuse' attribute) */
+long get_num_reused_hashsums(void);
+
 void print_match(char*, rx_rule*, match_result, RESTRICTION_TYPE);
 #endif /*_GEN_LIST_H_INCLUDED*/
@@ -22,6 +22,7 @@
 #define _HASHSUM_H_INCLUDED
 
 #include "attributes.h"
+#include <limits.h>
 #include <stdbool.h>
 
 typedef struct {
@@ -43,6 +44,10 @@ typedef enum {
     hash_gostr3411_94,
     hash_stribog256,
     hash_stribog512,
+    hash_merkle,
+    hash_blake3,
+    hash_xxh128,
+    hash_sampled,
     num_hashes,
 } HASHSUM;
 
@@ -53,6 +58,12 @@ extern hashsum_t hashsums[];
 
 extern int algorithms[];
 
+/* algorithms[] value of the hashsums not calculated by mhash or gcrypt */
+#define ALGORITHM_OTHER INT_MAX
+
+/* hashsums which are not part of H and the default database_attrs */
+#define OPT_IN_HASHES (ATTR(attr_merkle)|ATTR(attr_sampled))
+
 DB_ATTR_TYPE get_hashes(bool);
 
 #endif /* _HASHSUM_H_INCLUDED */
@@ -0,0 +1,65 @@
+/*
+ * AIDE (Advanced Intrusion Detection Environment)
+ *
+ * Copyright (C) 2026 Hannes von Haugwitz
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef _HW_HASH_H_INCLUDED
+#define _HW_HASH_H_INCLUDED
+
+#include <stddef.h>
+#include <stdint.h>
+#include "attributes.h"
+#include "hashsum.h"
+
+/*
+ * SHA-1 and SHA-256 using the SHA instructions of the CPU (x86 SHA
+ * extensions or ARMv8 cryptography extensions), the instructions are
+ * detected at runtime, they are not used if libgcrypt is in FIPS mode
+ */
+
+typedef struct hw_hash_ctx {
+    uint32_t state[8];
+    unsigned char buf[64];
+    size_t buf_len;
+    uint64_t length;
+    void (*compress)(uint32_t *, const unsigned char *, size_t);
+} hw_hash_ctx;
+
+/* returns the hashsum attributes supported by the CPU (0 if none) */
+DB_ATTR_TYPE hw_hash_attrs(void);
+/* returns the name of the used instructions or NULL */
+const char *hw_hash_implementation(void);
+
+/*
+ * SHA-256 of several messages at once in the SIMD lanes of the CPU (AVX2 or
+ * AVX-512), each lane hashes one message (multi-buffer hashing)
+ */
+
+#define HW_HASH_MAX_LANES 16
+
+/* returns the number of lanes (0 if not supported) */
+int hw_hash_multi_lanes(void);
+/* n has to be less or equal hw_hash_multi_lanes() */
+void hw_hash_sha256_multi(const unsigned char **, const size_t *, int n, unsigned char (*)[32]);
+
+/* hashsum has to be in hw_hash_attrs() */
+void hw_hash_init(hw_hash_ctx *, HASHSUM);
+void hw_hash_update(hw_hash_ctx *, const void *, size_t);
+void hw_hash_final(hw_hash_ctx *, HASHSUM, unsigned char *);
+
+#endif /* _HW_HASH_H_INCLUDED */
@@ -0,0 +1,45 @@
+/*
+ * AIDE (Advanced Intrusion Detection Environment)
+ *
+ * Copyright (C) 2026 Hannes von Haugwitz
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef _IO_LIMIT_H_INCLUDED
+#define _IO_LIMIT_H_INCLUDED
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+#define IOPRIO_CLASS_BEST_EFFORT 2
+#define IOPRIO_CLASS_IDLE 3
+#define IOPRIO_VALUE(class, level) (((class) << 13) | (level))
+
+/*
+ * io_limit_read()
+ * accounts a read of size bytes from device dev against the read rate and
+ * IOPS limits (see max_read_rate option), sleeps until the read is allowed
+ */
+void io_limit_read(dev_t dev, size_t size);
+
+/* returns true if a read rate or IOPS limit is set */
+bool io_limit_enabled(void);
+
+/* sets the I/O priority and the nice level of the calling (worker) thread */
+void io_limit_set_worker_priority(const char *whoami);
+
+#endif /* _IO_LIMIT_H_INCLUDED */
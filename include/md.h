@@ -29,10 +29,19 @@
 #ifdef WITH_GCRYPT
 #include <gcrypt.h>
 #endif
+#ifdef WITH_BLAKE3
+#include <blake3.h>
+#endif
+#ifdef WITH_XXHASH
+#include <xxhash.h>
+#endif
+#include <stdbool.h>
 #include <sys/types.h>
 #include "attributes.h"
 #include "hashsum.h"
+#include "hw_hash.h"
 struct db_line;
+struct md_merkle;
 
 /*
   This struct hold's internal data needed for md-calls.
@@ -49,6 +58,10 @@ typedef struct md_container {
     After init hold's hashes which are not calculated :)
   */
   DB_ATTR_TYPE todo_attr;
+  /*
+    Calculate the hashsums on separate threads (set before init_md).
+  */
+  bool parallel;
 
   /*
     Variables needed to cope with the library.
@@ -59,7 +72,26 @@ typedef struct md_container {
 
 #ifdef WITH_GCRYPT
   gcry_md_hd_t mdh;
+  /* one handle per hashsum if parallel */
+  gcry_md_hd_t parallel_mdh[num_hashes];
+#endif
+  /*
+    Hashsums calculated in md.c or by other libraries (merkle, blake3, xxh128).
+  */
+  DB_ATTR_TYPE builtin_attr;
+  struct md_merkle *merkle;
+#ifdef WITH_BLAKE3
+  blake3_hasher blake3;
+#endif
+#ifdef WITH_XXHASH
+  XXH3_state_t *xxh3;
 #endif
+  /*
+    Hashsums calculated by the SHA instructions of the CPU (see hw_hash.h),
+    they are part of builtin_attr.
+  */
+  DB_ATTR_TYPE hw_attr;
+  hw_hash_ctx hw_hash[num_hashes];
 
 } md_container;
 
@@ -71,6 +103,8 @@ typedef struct md_hashsums {
 int init_md(struct md_container*, const char*);
 int update_md(struct md_container*,void*,ssize_t);
 int close_md(struct md_container*, md_hashsums *, const char*);
+int reset_md(struct md_container*, const char*);
+void free_md(struct md_container*);
 void hashsums2line(md_hashsums*, struct db_line*);
 
 #endif /*_MD_H_INCLUDED*/
@@ -46,5 +46,8 @@ struct seltree {
 
   DB_ATTR_TYPE changed_attrs;
 
+  /* hashsums of the old entries of the children (see 'compressed' attribute) */
+  tree_node *old_hashsums;
+
 };
 #endif /* _SELTREE_STRUCT_H_INCLUDED */
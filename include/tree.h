@@ -33,4 +33,7 @@ tree_node *tree_walk_next(tree_node *);
 
 void *tree_get_data(tree_node *n);
 
+/* frees the nodes of the tree, but not the keys and data */
+void tree_free(tree_node *);
+
 #endif
@@ -0,0 +1,63 @@
+/*
+ * AIDE (Advanced Intrusion Detection Environment)
+ *
+ * Copyright (C) 2026 Hannes von Haugwitz
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef _URING_H_INCLUDED
+#define _URING_H_INCLUDED
+
+#include "config.h"
+#include <stdbool.h>
+#include <sys/stat.h>
+#include "attributes.h"
+#include "md.h"
+
+/*
+ * io_uring based hashsum calculation: the open, statx and read requests of
+ * several files are submitted at once, a file is returned by
+ * uring_engine_wait() when its hashsums are calculated
+ */
+
+typedef struct uring_engine uring_engine;
+
+/* maximum number of files processed at once per engine (at most one request each) */
+#define URING_FILES 32
+
+/* returns NULL if io_uring is not available */
+uring_engine *uring_engine_init(const char *);
+void uring_engine_free(uring_engine *);
+
+bool uring_engine_full(uring_engine *);
+bool uring_engine_empty(uring_engine *);
+
+/*
+ * uring_engine_add()
+ * data: payload returned by uring_engine_wait()
+ * dirfd, name: file to be opened (name must be valid until the file is returned)
+ * returns false if the engine is full
+ */
+bool uring_engine_add(uring_engine *, void *data, int dirfd, const char *name, char *fullpath, DB_ATTR_TYPE, struct stat *);
+
+/*
+ * uring_engine_wait()
+ * filedes: set to the still opened file descriptor or -1
+ * md_hash: set to the calculated hashsums (attrs is 0 on error)
+ */
+void *uring_engine_wait(uring_engine *, int *filedes, md_hashsums *md_hash);
+
+#endif /* _URING_H_INCLUDED */
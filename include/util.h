@@ -26,6 +26,7 @@
 #include <stdbool.h>
 #include <inttypes.h>
 #include <sys/types.h>
+#include <sys/stat.h>
 #include <stdarg.h>
 #include "url.h"
 
@@ -114,4 +115,8 @@ size_t strnlen(const char *s, size_t maxlen);
 int syslog_facility_lookup(char *);
 #endif
 
+#ifdef HAVE_STATX
+void statx2stat(struct statx *, struct stat *);
+#endif
+
 #endif
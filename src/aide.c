@@ -39,6 +39,7 @@
 
 #include "attributes.h"
 #include "hashsum.h"
+#include "hw_hash.h"
 #include "rx_rule.h"
 #include "url.h"
 #include "commandconf.h"
@@ -94,6 +95,7 @@ static void usage(int exitvalue)
 	    "  -A \"OPTION\"\t--after=\"OPTION\"\tAfter configuration file is read define OPTION\n"
 	    "  -L LEVEL\t--log-level=LEVEL\tSet log message level to LEVEL\n"
 	    "  -W WORKERS\t--workers=WORKERS\tNumber of simultaneous workers (threads) for file attribute processing (i.a. hashsum calculation)\n"
+	    "  \t\t--max-read-rate=RATE\tLimit the read rate of the hashsum calculation to RATE bytes per second (suffixes: K, M, G)\n"
 	    "  \t\t--no-progress\t\tTurn progress off explicitly\n"
 	    "  \t\t--no-color\t\tTUrn color off explicitly\n"
 	    ), conf->aide_version
@@ -204,6 +206,13 @@ static void print_version(void)
       fprintf(stdout, "%s: %s\n", attributes[hashsums[i].attribute].config_name, ATTR(hashsums[i].attribute)&available_hashsums?"yes":"no");
   }
 
+  const char *hw_implementation = hw_hash_implementation();
+  if (hw_implementation) {
+      char *str;
+      fprintf(stdout, "\nHardware accelerated hashsum attributes (%s): %s\n", hw_implementation, str = diff_attributes(0, hw_hash_attrs()));
+      free(str);
+  }
+
   fprintf(stdout, "\nDefault compound groups:\n");
   char* predefined_groups[] = { "R", "L", ">", "H", "X" };
   for (unsigned long i = 0 ; i < sizeof(predefined_groups)/sizeof(char*); ++i) {
@@ -254,6 +263,7 @@ static void read_param(int argc,char**argv)
       ARG_NO_PROGRESS = 1,
       ARG_LIST        = 2,
       ARG_NO_COLOR    = 3,
+      ARG_MAX_READ_RATE = 4,
   };
 
   static struct option options[] =
@@ -274,6 +284,7 @@ static void read_param(int argc,char**argv)
     { "workers", required_argument, NULL, 'W'},
     { "no-progress", no_argument, NULL, ARG_NO_PROGRESS},
     { "no-color", no_argument, NULL, ARG_NO_COLOR},
+    { "max-read-rate", required_argument, NULL, ARG_MAX_READ_RATE},
     { "compare", no_argument, NULL, 'E'},
     { "list", no_argument, NULL, ARG_LIST},
     { NULL,0,NULL,0 }
@@ -362,6 +373,15 @@ static void read_param(int argc,char**argv)
            log_msg(LOG_LEVEL_INFO,"(--no-progress): disable progress bar");
            break;
       }
+      case ARG_MAX_READ_RATE:{
+           long long max_read_rate = do_rate(optarg);
+           if (max_read_rate < 0) {
+               INVALID_ARGUMENT("--max-read-rate", invalid read rate '%s', optarg)
+           }
+           conf->max_read_rate = max_read_rate;
+           log_msg(LOG_LEVEL_INFO,"(--max-read-rate): set maximum read rate to %lld bytes per second (argument value: '%s')", conf->max_read_rate, optarg);
+           break;
+      }
       case ARG_NO_COLOR:{
            conf->no_color = false;
            log_msg(LOG_LEVEL_INFO,"(--no-color): disable colored log output");
@@ -509,7 +529,7 @@ static void setdefaults_before_config(void)
   conf->database_new.db_line = NULL;
   conf->database_new.created = false;
 
-  conf->db_attrs = get_hashes(false);
+  conf->db_attrs = get_hashes(false)&~OPT_IN_HASHES;
   
 #ifdef WITH_ZLIB
   conf->gzip_dbout=0;
@@ -518,6 +538,29 @@ static void setdefaults_before_config(void)
   conf->action=0;
 
   conf->num_workers = -1;
+  conf->num_scan_workers = -1;
+  conf->num_workers_per_device = -1;
+  conf->device_num_workers = NULL;
+  conf->statx_dont_sync = false;
+  conf->scan_inode_order = false;
+  conf->hash_extent_order = false;
+  conf->io_uring = false;
+  conf->one_file_system = false;
+  conf->skip_pseudo_filesystems = false;
+  conf->hash_mmap = false;
+  conf->hash_readahead = false;
+  conf->parallel_hashsums = false;
+  conf->xxh128_shortcut = false;
+  conf->multi_buffer_hashsums = false;
+  conf->max_read_rate = -1;
+  conf->max_read_iops = 0;
+  conf->max_device_read_rate = 0;
+  conf->max_device_read_iops = 0;
+  conf->worker_ioprio = -1;
+  conf->worker_nice = 0;
+  conf->hash_direct_io = false;
+  conf->sampled_hash_size = 1048576;
+  conf->sampled_hash_windows = 16;
 
   conf->warn_dead_symlinks=0;
 
@@ -585,7 +628,7 @@ static void setdefaults_before_config(void)
   do_groupdef("R",common_attrs|ATTR(attr_size)|ATTR(attr_linkname)|ATTR(attr_mtime)|ATTR(attr_ctime)|GROUP_R_HASHES|X);
   do_groupdef("L",common_attrs|ATTR(attr_linkname)|X);
   do_groupdef(">",common_attrs|ATTR(attr_size)|ATTR(attr_growing)|ATTR(attr_linkname)|X);
-  do_groupdef("H",get_hashes(false));
+  do_groupdef("H",get_hashes(false)&~OPT_IN_HASHES);
   do_groupdef("X",X);
   do_groupdef("E",0);
 
@@ -623,6 +666,21 @@ static void setdefaults_after_config(void)
       log_msg(LOG_LEVEL_CONFIG, "(default): set 'num_workers' option to %lu", conf->num_workers);
   }
 
+  if(conf->num_scan_workers < 0) {
+      conf->num_scan_workers = 1;
+      log_msg(LOG_LEVEL_CONFIG, "(default): set 'num_scan_workers' option to %lu", conf->num_scan_workers);
+  }
+
+  if(conf->num_workers_per_device < 0) {
+      conf->num_workers_per_device = 0;
+      log_msg(LOG_LEVEL_CONFIG, "(default): set 'num_workers_per_device' option to %lu", conf->num_workers_per_device);
+  }
+
+  if(conf->max_read_rate < 0) {
+      conf->max_read_rate = 0;
+      log_msg(LOG_LEVEL_CONFIG, "(default): set 'max_read_rate' option to %lld", conf->max_read_rate);
+  }
+
   if (is_log_level_unset()) {
           set_log_level(LOG_LEVEL_WARNING);
   };
@@ -879,6 +937,10 @@ int main(int argc,char**argv)
           exit(THREAD_ERROR);
     }
 
+    if(conf->action&DO_COMPARE) {
+      free_old_hashsums_index(conf->tree);
+    }
+
     if(conf->action&DO_INIT) {
         progress_status(PROGRESS_WRITEDB, NULL);
         log_msg(LOG_LEVEL_INFO, "write new entries to database: %s:%s", get_url_type_string((conf->database_out.url)->type), (conf->database_out.url)->value);
@@ -68,6 +68,11 @@ attributes_t attributes[] = {
     { ATTR(attr_stribog512),     "stribog512",   "STRIBOG512",  "stribog512",   "stribog512",   '\0'  },
     { ATTR(attr_growing),        "growing",      NULL,          NULL,           NULL,           '\0'  },
     { ATTR(attr_compressed),     "compressed",   NULL,          NULL,           NULL,           '\0'  },
+    { ATTR(attr_merkle),         "merkle",       "MERKLE",      "merkle",       "merkle",       '\0'  },
+    { ATTR(attr_blake3),         "blake3",       "BLAKE3",      "blake3",       "blake3",       '\0'  },
+    { ATTR(attr_xxh128),         "xxh128",       "XXH128",      "xxh128",       "xxh128",       '\0'  },
+    { ATTR(attr_reuse),          "reuse",        NULL,          NULL,           NULL,           '\0'  },
+    { ATTR(attr_sampled),        "sampled",      "SAMPLED",     "sampled",      "sampled",      '\0'  },
 };
 
 DB_ATTR_TYPE num_attrs = sizeof(attributes)/sizeof(attributes_t);
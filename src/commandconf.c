@@ -25,12 +25,15 @@
 #include <string.h>
 #include <unistd.h>
 #include <stdbool.h>
+#include <limits.h>
+#include <sys/sysmacros.h>
 #include <zlib.h>
 #include "attributes.h"
 #include "conf_ast.h"
 #include "config.h"
 #include "errorcodes.h"
 #include "hashsum.h"
+#include "io_limit.h"
 #include "list.h"
 #include "rx_rule.h"
 #include "url.h"
@@ -367,6 +370,10 @@ bool add_rx_rule_to_tree(char* rx, char* rule_prefix, RESTRICTION_TYPE restricti
         if (attr&ATTR(attr_compressed) && !(attr&get_hashes(false))) {
             log_msg(LOG_LEVEL_WARNING, "%s:%d: ignore 'comprressed' attribute (no hashsum attributes are set) (line: '%s')", filename, linenumber, linebuf);
         }
+        DB_ATTR_TYPE reuse_attrs = ATTR(attr_inode)|ATTR(attr_size)|ATTR(attr_mtime)|ATTR(attr_ctime);
+        if (attr&ATTR(attr_reuse) && (!(attr&get_hashes(false)) || (attr&reuse_attrs) != reuse_attrs)) {
+            log_msg(LOG_LEVEL_WARNING, "%s:%d: ignore 'reuse' attribute (no hashsum attributes or not all of the 'i', 's', 'm' and 'c' attributes are set) (line: '%s')", filename, linenumber, linebuf);
+        }
         conf->db_out_attrs |= attr;
 
         LOG_CONFIG_FORMAT_LINE_PREFIX(LOG_LEVEL_CONFIG, "add %s '%s%s %s %s' to node '%s'", get_rule_type_long_string(type), get_rule_type_char(type), r->rx, rs_str = get_restriction_string(r->restriction), attr_str = diff_attributes(0, r->attr), node_path)
@@ -545,6 +552,91 @@ long do_num_workers(const char *str) {
     return number;
 }
 
+/*
+ * do_size()
+ * parses a size in bytes (e.g. '4M'), the suffixes 'K', 'M' and 'G' multiply
+ * by 1024, 1024^2 and 1024^3, returns -1 on error
+ */
+long long do_size(const char *str) {
+    char *err;
+    errno = 0;
+    long long number = strtoll(str,&err,10);
+    if (err == str || number < 0 || errno == ERANGE) {
+        return -1;
+    }
+    int shift = 0;
+    switch (*err) {
+        case 'K': shift = 10; err++; break;
+        case 'M': shift = 20; err++; break;
+        case 'G': shift = 30; err++; break;
+    }
+    if (*err != '\0' || number > (LLONG_MAX >> shift)) {
+        return -1;
+    }
+    return number << shift;
+}
+
+/*
+ * do_rate()
+ * parses a rate (e.g. '50M') per second with the suffixes of do_size(),
+ * returns -1 on error
+ */
+long long do_rate(const char *str) {
+    return do_size(str);
+}
+
+/*
+ * do_ioprio()
+ * parses 'idle', 'best-effort' or 'best-effort:<level>' (level: 0 (highest)
+ * to 7 (lowest), default: 7), returns the ioprio value or -1 on error
+ */
+int do_ioprio(const char *str) {
+    if (strcmp(str, "idle") == 0) {
+        return IOPRIO_VALUE(IOPRIO_CLASS_IDLE, 0);
+    } else if (strcmp(str, "best-effort") == 0) {
+        return IOPRIO_VALUE(IOPRIO_CLASS_BEST_EFFORT, 7);
+    } else if (strncmp(str, "best-effort:", 12) == 0 && str[12] >= '0' && str[12] <= '7' && str[13] == '\0') {
+        return IOPRIO_VALUE(IOPRIO_CLASS_BEST_EFFORT, str[12] - '0');
+    }
+    return -1;
+}
+
+/*
+ * do_device_num_workers()
+ * parses '<path>:<number>' or '<major>:<minor>:<number>', the number is given
+ * like for do_num_workers(), returns NULL on error
+ */
+device_num_workers *do_device_num_workers(const char *str) {
+    const char *sep = strrchr(str, ':');
+    if (sep == NULL || sep == str || sep[1] == '\0') {
+        return NULL;
+    }
+    long num_workers = do_num_workers(sep + 1);
+    if (num_workers < 0) {
+        return NULL;
+    }
+    char *path = NULL;
+    dev_t dev = 0;
+    if (str[0] == '/') {
+        path = checked_malloc(sep - str + 1); /* freed by caller */
+        strncpy(path, str, sep - str);
+        path[sep - str] = '\0';
+    } else {
+        unsigned int dev_major, dev_minor;
+        int n = -1;
+        if (sscanf(str, "%u:%u%n", &dev_major, &dev_minor, &n) != 2 || str + n != sep) {
+            return NULL;
+        }
+        dev = makedev(dev_major, dev_minor);
+    }
+    device_num_workers *device = checked_malloc(sizeof(device_num_workers)); /* freed by caller */
+    device->path = path;
+    device->resolved = path == NULL;
+    device->dev = dev;
+    device->num_workers = num_workers;
+    return device;
+}
+
 #ifdef WITH_E2FSATTRS
 void do_report_ignore_e2fsattrs(char* val, int linenumber, char* filename, char* linebuf) {
     conf->report_ignore_e2fsattrs = 0UL;
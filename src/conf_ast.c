@@ -58,6 +58,29 @@ config_option_t config_options[] = {
     { REPORT_FORMAT_OPTION,                     NULL,                           NULL },
     { LIMIT_CMDLINE_OPTION,                     "limit",                        "Limit" },
     { NUM_WORKERS,                              NULL,                           NULL },
+    { NUM_SCAN_WORKERS,                         NULL,                           NULL },
+    { STATX_DONT_SYNC_OPTION,                   NULL,                           NULL },
+    { SCAN_INODE_ORDER_OPTION,                  NULL,                           NULL },
+    { HASH_EXTENT_ORDER_OPTION,                 NULL,                           NULL },
+    { IO_URING_OPTION,                          NULL,                           NULL },
+    { NUM_WORKERS_PER_DEVICE,                   NULL,                           NULL },
+    { DEVICE_NUM_WORKERS_OPTION,                NULL,                           NULL },
+    { ONE_FILE_SYSTEM_OPTION,                   NULL,                           NULL },
+    { SKIP_PSEUDO_FILESYSTEMS_OPTION,           NULL,                           NULL },
+    { HASH_MMAP_OPTION,                        NULL,                           NULL },
+    { HASH_READAHEAD_OPTION,                   NULL,                           NULL },
+    { PARALLEL_HASHSUMS_OPTION,                NULL,                           NULL },
+    { XXH128_SHORTCUT_OPTION,                  NULL,                           NULL },
+    { MULTI_BUFFER_HASHSUMS_OPTION,            NULL,                           NULL },
+    { MAX_READ_RATE_OPTION,                    NULL,                           NULL },
+    { MAX_READ_IOPS_OPTION,                    NULL,                           NULL },
+    { MAX_DEVICE_READ_RATE_OPTION,             NULL,                           NULL },
+    { MAX_DEVICE_READ_IOPS_OPTION,             NULL,                           NULL },
+    { WORKER_IOPRIO_OPTION,                    NULL,                           NULL },
+    { WORKER_NICE_OPTION,                      NULL,                           NULL },
+    { HASH_DIRECT_IO_OPTION,                   NULL,                           NULL },
+    { SAMPLED_HASH_SIZE_OPTION,                NULL,                           NULL },
+    { SAMPLED_HASH_WINDOWS_OPTION,             NULL,                           NULL },
 };
 
 static ast* new_ast_node(void) {
@@ -29,6 +29,7 @@
 #include "conf_ast.h"
 #include "db_config.h"
 #include "hashsum.h"
+#include "hw_hash.h"
 #include "list.h"
 #include "report.h"
 
@@ -39,6 +40,7 @@
 #include "log.h"
 #include "errorcodes.h"
 #include "db.h"
+#include "do_md.h"
 #include "rx_rule.h"
 #include "util.h"
 
@@ -51,6 +53,7 @@
 #include <sys/wait.h>
 #include <dirent.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <unistd.h>
 
 LOG_LEVEL eval_log_level = LOG_LEVEL_TRACE;
@@ -252,6 +255,65 @@ static void eval_config_statement(config_option_statement statement, int linenum
         BOOL_CONFIG_OPTION_CASE(REPORT_SUMMARIZE_CHANGES_OPTION, report_summarize_changes)
         BOOL_CONFIG_OPTION_CASE(WARN_DEAD_SYMLINKS_OPTION, warn_dead_symlinks)
         BOOL_CONFIG_OPTION_CASE(CONFIG_CHECK_WARN_UNRESTRICTED_RULES, config_check_warn_unrestricted_rules)
+        BOOL_CONFIG_OPTION_CASE(SCAN_INODE_ORDER_OPTION, scan_inode_order)
+        BOOL_CONFIG_OPTION_CASE(HASH_EXTENT_ORDER_OPTION, hash_extent_order)
+        BOOL_CONFIG_OPTION_CASE(ONE_FILE_SYSTEM_OPTION, one_file_system)
+        BOOL_CONFIG_OPTION_CASE(HASH_MMAP_OPTION, hash_mmap)
+        case HASH_READAHEAD_OPTION:
+#ifdef HAVE_POSIX_FADVISE
+            b = string_expression_to_bool(statement.e, linenumber, filename, linebuf);
+            conf->hash_readahead = b;
+            LOG_CONFIG_FORMAT_LINE(LOG_LEVEL_CONFIG, "set 'hash_readahead' to '%s'", btoa(conf->hash_readahead))
+#else
+            LOG_CONFIG_FORMAT_LINE(LOG_LEVEL_NOTICE, "%s", "posix_fadvise() is not available, ignore 'hash_readahead' option")
+#endif
+            break;
+        BOOL_CONFIG_OPTION_CASE(PARALLEL_HASHSUMS_OPTION, parallel_hashsums)
+        case XXH128_SHORTCUT_OPTION:
+#ifdef WITH_XXHASH
+            b = string_expression_to_bool(statement.e, linenumber, filename, linebuf);
+            conf->xxh128_shortcut = b;
+            LOG_CONFIG_FORMAT_LINE(LOG_LEVEL_CONFIG, "set 'xxh128_shortcut' to '%s'", btoa(conf->xxh128_shortcut))
+#else
+            LOG_CONFIG_FORMAT_LINE(LOG_LEVEL_NOTICE, "%s", "xxHash support not compiled in, ignore 'xxh128_shortcut' option")
+#endif
+            break;
+        case MULTI_BUFFER_HASHSUMS_OPTION:
+            b = string_expression_to_bool(statement.e, linenumber, filename, linebuf);
+            if (b && hw_hash_multi_lanes() == 0) {
+                LOG_CONFIG_FORMAT_LINE(LOG_LEVEL_NOTICE, "%s", "multi-buffer hashing is not supported by the CPU, ignore 'multi_buffer_hashsums' option")
+                b = false;
+            }
+            conf->multi_buffer_hashsums = b;
+            LOG_CONFIG_FORMAT_LINE(LOG_LEVEL_CONFIG, "set 'multi_buffer_hashsums' to '%s'", btoa(conf->multi_buffer_hashsums))
+            break;
+        case SKIP_PSEUDO_FILESYSTEMS_OPTION:
+#if defined(HAVE_SYS_VFS_H) && defined(HAVE_LINUX_MAGIC_H)
+            b = string_expression_to_bool(statement.e, linenumber, filename, linebuf);
+            conf->skip_pseudo_filesystems = b;
+            LOG_CONFIG_FORMAT_LINE(LOG_LEVEL_CONFIG, "set 'skip_pseudo_filesystems' to '%s'", btoa(conf->skip_pseudo_filesystems))
+#else
+            LOG_CONFIG_FORMAT_LINE(LOG_LEVEL_NOTICE, "%s", "file system types cannot be detected, ignore 'skip_pseudo_filesystems' option")
+#endif
+            break;
+        case STATX_DONT_SYNC_OPTION:
+#ifdef HAVE_STATX
+            b = string_expression_to_bool(statement.e, linenumber, filename, linebuf);
+            conf->statx_dont_sync = b;
+            LOG_CONFIG_FORMAT_LINE(LOG_LEVEL_CONFIG, "set 'statx_dont_sync' to '%s'", btoa(conf->statx_dont_sync))
+#else
+            LOG_CONFIG_FORMAT_LINE(LOG_LEVEL_NOTICE, "%s", "statx() is not available, ignore 'statx_dont_sync' option")
+#endif
+            break;
+        case IO_URING_OPTION:
+#ifdef WITH_URING
+            b = string_expression_to_bool(statement.e, linenumber, filename, linebuf);
+            conf->io_uring = b;
+            LOG_CONFIG_FORMAT_LINE(LOG_LEVEL_CONFIG, "set 'io_uring' to '%s'", btoa(conf->io_uring))
+#else
+            LOG_CONFIG_FORMAT_LINE(LOG_LEVEL_NOTICE, "%s", "io_uring support not compiled in, ignore 'io_uring' option")
+#endif
+            break;
         case REPORT_LEVEL_OPTION:
             str = eval_string_expression(statement.e, linenumber, filename, linebuf);
             if(!do_reportlevel(str, linenumber, filename, linebuf)) {
@@ -315,6 +377,140 @@ static void eval_config_statement(config_option_statement statement, int linenum
                     LOG_CONFIG_FORMAT_LINE(LOG_LEVEL_NOTICE, "'num_workers' option already set (ignore new value '%s')", str)
             }
             break;
+        case NUM_SCAN_WORKERS:
+            str = eval_string_expression(statement.e, linenumber, filename, linebuf);
+
+            if (conf->num_scan_workers < 0) {
+                long num_scan_workers = do_num_workers(str);
+                if (num_scan_workers < 0) {
+                    LOG_CONFIG_FORMAT_LINE(LOG_LEVEL_ERROR, "invalid number of scan workers: '%s'", str);
+                    exit(INVALID_CONFIGURELINE_ERROR);
+                }
+                conf->num_scan_workers = num_scan_workers;
+                LOG_CONFIG_FORMAT_LINE(LOG_LEVEL_CONFIG, "set 'num_scan_workers' option to %ld (config value: '%s')", conf->num_scan_workers, str)
+            } else {
+                    LOG_CONFIG_FORMAT_LINE(LOG_LEVEL_NOTICE, "'num_scan_workers' option already set (ignore new value '%s')", str)
+            }
+            break;
+        case NUM_WORKERS_PER_DEVICE:
+            str = eval_string_expression(statement.e, linenumber, filename, linebuf);
+
+            if (conf->num_workers_per_device < 0) {
+                long num_workers_per_device = do_num_workers(str);
+                if (num_workers_per_device < 0) {
+                    LOG_CONFIG_FORMAT_LINE(LOG_LEVEL_ERROR, "invalid number of workers per device: '%s'", str);
+                    exit(INVALID_CONFIGURELINE_ERROR);
+                }
+                conf->num_workers_per_device = num_workers_per_device;
+                LOG_CONFIG_FORMAT_LINE(LOG_LEVEL_CONFIG, "set 'num_workers_per_device' option to %ld (config value: '%s')", conf->num_workers_per_device, str)
+            } else {
+                    LOG_CONFIG_FORMAT_LINE(LOG_LEVEL_NOTICE, "'num_workers_per_device' option already set (ignore new value '%s')", str)
+            }
+            break;
+        case DEVICE_NUM_WORKERS_OPTION:
+            str = eval_string_expression(statement.e, linenumber, filename, linebuf);
+
+            device_num_workers *device = do_device_num_workers(str);
+            if (device == NULL) {
+                LOG_CONFIG_FORMAT_LINE(LOG_LEVEL_ERROR, "invalid number of workers for device: '%s'", str);
+                exit(INVALID_CONFIGURELINE_ERROR);
+            }
+            conf->device_num_workers = list_append(conf->device_num_workers, (void*) device);
+            LOG_CONFIG_FORMAT_LINE(LOG_LEVEL_CONFIG, "add 'device_num_workers' limit of %ld (config value: '%s')", device->num_workers, str)
+            break;
+        case MAX_READ_RATE_OPTION:
+            str = eval_string_expression(statement.e, linenumber, filename, linebuf);
+
+            if (conf->max_read_rate < 0) {
+                long long max_read_rate = do_rate(str);
+                if (max_read_rate < 0) {
+                    LOG_CONFIG_FORMAT_LINE(LOG_LEVEL_ERROR, "invalid read rate: '%s'", str);
+                    exit(INVALID_CONFIGURELINE_ERROR);
+                }
+                conf->max_read_rate = max_read_rate;
+                LOG_CONFIG_FORMAT_LINE(LOG_LEVEL_CONFIG, "set 'max_read_rate' option to %lld (config value: '%s')", conf->max_read_rate, str)
+            } else {
+                    LOG_CONFIG_FORMAT_LINE(LOG_LEVEL_NOTICE, "'max_read_rate' option already set (ignore new value '%s')", str)
+            }
+            break;
+        case MAX_READ_IOPS_OPTION:
+            str = eval_string_expression(statement.e, linenumber, filename, linebuf);
+            conf->max_read_iops = do_rate(str);
+            if (conf->max_read_iops < 0) {
+                LOG_CONFIG_FORMAT_LINE(LOG_LEVEL_ERROR, "invalid number of read requests: '%s'", str);
+                exit(INVALID_CONFIGURELINE_ERROR);
+            }
+            LOG_CONFIG_FORMAT_LINE(LOG_LEVEL_CONFIG, "set 'max_read_iops' option to %lld (config value: '%s')", conf->max_read_iops, str)
+            break;
+        case MAX_DEVICE_READ_RATE_OPTION:
+            str = eval_string_expression(statement.e, linenumber, filename, linebuf);
+            conf->max_device_read_rate = do_rate(str);
+            if (conf->max_device_read_rate < 0) {
+                LOG_CONFIG_FORMAT_LINE(LOG_LEVEL_ERROR, "invalid read rate: '%s'", str);
+                exit(INVALID_CONFIGURELINE_ERROR);
+            }
+            LOG_CONFIG_FORMAT_LINE(LOG_LEVEL_CONFIG, "set 'max_device_read_rate' option to %lld (config value: '%s')", conf->max_device_read_rate, str)
+            break;
+        case MAX_DEVICE_READ_IOPS_OPTION:
+            str = eval_string_expression(statement.e, linenumber, filename, linebuf);
+            conf->max_device_read_iops = do_rate(str);
+            if (conf->max_device_read_iops < 0) {
+                LOG_CONFIG_FORMAT_LINE(LOG_LEVEL_ERROR, "invalid number of read requests: '%s'", str);
+                exit(INVALID_CONFIGURELINE_ERROR);
+            }
+            LOG_CONFIG_FORMAT_LINE(LOG_LEVEL_CONFIG, "set 'max_device_read_iops' option to %lld (config value: '%s')", conf->max_device_read_iops, str)
+            break;
+        case WORKER_IOPRIO_OPTION:
+            str = eval_string_expression(statement.e, linenumber, filename, linebuf);
+            conf->worker_ioprio = do_ioprio(str);
+            if (conf->worker_ioprio < 0) {
+                LOG_CONFIG_FORMAT_LINE(LOG_LEVEL_ERROR, "invalid I/O priority: '%s' (expected 'idle', 'best-effort' or 'best-effort:<0-7>')", str);
+                exit(INVALID_CONFIGURELINE_ERROR);
+            }
+            LOG_CONFIG_FORMAT_LINE(LOG_LEVEL_CONFIG, "set 'worker_ioprio' option to %d (config value: '%s')", conf->worker_ioprio, str)
+            break;
+        case WORKER_NICE_OPTION: {
+            str = eval_string_expression(statement.e, linenumber, filename, linebuf);
+            char *err;
+            long worker_nice = strtol(str, &err, 10);
+            if (*str == '\0' || *err != '\0' || worker_nice < -20 || worker_nice > 19) {
+                LOG_CONFIG_FORMAT_LINE(LOG_LEVEL_ERROR, "invalid nice level: '%s' (expected -20 to 19)", str);
+                exit(INVALID_CONFIGURELINE_ERROR);
+            }
+            conf->worker_nice = worker_nice;
+            LOG_CONFIG_FORMAT_LINE(LOG_LEVEL_CONFIG, "set 'worker_nice' option to %d", conf->worker_nice)
+            break;
+        }
+        case HASH_DIRECT_IO_OPTION:
+#ifdef O_DIRECT
+            b = string_expression_to_bool(statement.e, linenumber, filename, linebuf);
+            conf->hash_direct_io = b;
+            LOG_CONFIG_FORMAT_LINE(LOG_LEVEL_CONFIG, "set 'hash_direct_io' to '%s'", btoa(conf->hash_direct_io))
+#else
+            LOG_CONFIG_FORMAT_LINE(LOG_LEVEL_NOTICE, "%s", "O_DIRECT is not available, ignore 'hash_direct_io' option")
+#endif
+            break;
+        case SAMPLED_HASH_SIZE_OPTION:
+            str = eval_string_expression(statement.e, linenumber, filename, linebuf);
+            conf->sampled_hash_size = do_size(str);
+            if (conf->sampled_hash_size <= 0 || conf->sampled_hash_size > SAMPLED_HASH_MAX_SIZE) {
+                LOG_CONFIG_FORMAT_LINE(LOG_LEVEL_ERROR, "invalid sampled hash size: '%s' (expected 1 to 1G)", str);
+                exit(INVALID_CONFIGURELINE_ERROR);
+            }
+            LOG_CONFIG_FORMAT_LINE(LOG_LEVEL_CONFIG, "set 'sampled_hash_size' option to %lld (config value: '%s')", conf->sampled_hash_size, str)
+            break;
+        case SAMPLED_HASH_WINDOWS_OPTION: {
+            str = eval_string_expression(statement.e, linenumber, filename, linebuf);
+            char *err;
+            long sampled_hash_windows = strtol(str, &err, 10);
+            if (*str == '\0' || *err != '\0' || sampled_hash_windows < 0 || sampled_hash_windows > SAMPLED_HASH_MAX_WINDOWS) {
+                LOG_CONFIG_FORMAT_LINE(LOG_LEVEL_ERROR, "invalid number of sampled hash windows: '%s' (expected 0 to %d)", str, SAMPLED_HASH_MAX_WINDOWS);
+                exit(INVALID_CONFIGURELINE_ERROR);
+            }
+            conf->sampled_hash_windows = sampled_hash_windows;
+            LOG_CONFIG_FORMAT_LINE(LOG_LEVEL_CONFIG, "set 'sampled_hash_windows' option to %ld", conf->sampled_hash_windows)
+            break;
+        }
     }
 }
 
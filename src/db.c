@@ -311,6 +311,10 @@ db_line* db_char2line(char** ss, database* db){
     CHAR2HASH(gostr3411_94)
     CHAR2HASH(stribog256)
     CHAR2HASH(stribog512)
+    CHAR2HASH(merkle)
+    CHAR2HASH(blake3)
+    CHAR2HASH(xxh128)
+    CHAR2HASH(sampled)
     case attr_acl : {
 #ifdef WITH_POSIX_ACL
       char *tval = NULL;
@@ -413,6 +417,7 @@ db_line* db_char2line(char** ss, database* db){
     case attr_allhashsums :
     case attr_growing :
     case attr_compressed :
+    case attr_reuse :
     case attr_allownewfile :
     case attr_allowrmfile : {
       /*  no db field */
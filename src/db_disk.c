@@ -27,12 +27,18 @@
 #include <sys/stat.h>
 #include <stdlib.h>
 #include <dirent.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/sysmacros.h>
 #include <errno.h>
 #include <stdbool.h>
 #include "db_config.h"
 #include "log.h"
 #include "rx_rule.h"
 #include "seltree.h"
+#include "seltree_struct.h"
 #include "gen_list.h"
 #include "db.h"
 #include "db_line.h"
@@ -40,24 +46,149 @@
 #include "util.h"
 #include "queue.h"
 #include "errorcodes.h"
+#include "hashsum.h"
+#include "do_md.h"
+#include "io_limit.h"
+
+#ifndef HAVE_STRUCT_DIRENT_D_TYPE
+#define DT_UNKNOWN 0
+#endif
+#ifndef DTTOIF
+#define DTTOIF(dirtype) ((dirtype) << 12)
+#endif
+
+#define GETDENTS_BUFFER_SIZE 1048576
+
+#ifndef NAME_MAX
+#define NAME_MAX 255
+#endif
+#ifdef WITH_E2FSATTRS
+#include "e2fsattrs.h"
+#endif
+#ifdef WITH_URING
+#include "uring.h"
+#endif
 
 #include <pthread.h>
 
-static int get_file_status(char *filename, struct stat *fs) {
+#if defined(HAVE_SYS_VFS_H) && defined(HAVE_LINUX_MAGIC_H)
+#define WITH_PSEUDO_FS_CHECK 1
+#include <sys/vfs.h>
+#include <linux/magic.h>
+#endif
+
+#ifdef HAVE_LINUX_FIEMAP_H
+#include <sys/ioctl.h>
+#include <linux/fs.h>
+#include <linux/fiemap.h>
+#endif
+
+#ifdef HAVE_STATX
+/* statx() may be compiled in but not supported by the running kernel */
+static bool use_statx = false;
+
+static unsigned int get_statx_mask(DB_ATTR_TYPE attr) {
+    if (attr&get_hashes(true)) {
+        /* calc_hashsums() compares all fields to detect changes during hashsum calculation */
+        return STATX_BASIC_STATS;
+    }
+    /* type, permissions and inode are always needed */
+    unsigned int mask = STATX_TYPE|STATX_MODE|STATX_INO;
+    if (attr&ATTR(attr_uid)) { mask |= STATX_UID; }
+    if (attr&ATTR(attr_gid)) { mask |= STATX_GID; }
+    if (attr&(ATTR(attr_size)|ATTR(attr_sizeg)|ATTR(attr_growing))) { mask |= STATX_SIZE; }
+    if (attr&ATTR(attr_linkcount)) { mask |= STATX_NLINK; }
+    if (attr&ATTR(attr_atime)) { mask |= STATX_ATIME; }
+    if (attr&ATTR(attr_mtime)) { mask |= STATX_MTIME; }
+    if (attr&ATTR(attr_ctime)) { mask |= STATX_CTIME; }
+    if (attr&ATTR(attr_bcount)) { mask |= STATX_BLOCKS; }
+    return mask;
+}
+
+/* fields requested by any rule, used if the matching rule is not yet known */
+static unsigned int rules_statx_mask = STATX_TYPE;
+
+static void add_rules_statx_mask(list *rules) {
+    for (list *l = rules ; l != NULL ; l = l->next) {
+        rules_statx_mask |= get_statx_mask(((rx_rule*) l->data)->attr);
+    }
+}
+
+static void init_rules_statx_mask(seltree *node) {
+    /* negative rules do not select any attributes */
+    add_rules_statx_mask(node->sel_rx_lst);
+    add_rules_statx_mask(node->equ_rx_lst);
+    for (tree_node *x = tree_walk_first(node->children) ; x != NULL ; x = tree_walk_next(x)) {
+        init_rules_statx_mask(tree_get_data(x));
+    }
+}
+
+#endif
+
+/*
+ * get_file_status()
+ * attr: attributes of the matching rule, 0 if the rule is not yet known (the
+ * fields needed by any rule are requested, so the result can be passed to
+ * get_matched_file_status() without a second call)
+ * e2fsattrs: set to the e2fs attributes if known from statx() or -1
+ */
+static int get_file_status(int dirfd, const char *name, char *filename, DB_ATTR_TYPE attr, struct stat *fs, long *e2fsattrs) {
     int sres = 0;
-    sres = lstat(filename,fs);
+    const char *function = "fstatat";
+    if (e2fsattrs) {
+        *e2fsattrs = -1;
+    }
+#ifdef HAVE_STATX
+    if (use_statx) {
+        struct statx stx;
+        function = "statx";
+        int flags = AT_SYMLINK_NOFOLLOW|AT_NO_AUTOMOUNT|(conf->statx_dont_sync?AT_STATX_DONT_SYNC:AT_STATX_SYNC_AS_STAT);
+        sres = statx(dirfd, name, flags, attr?get_statx_mask(attr):rules_statx_mask, &stx);
+        if (sres == 0) {
+            statx2stat(&stx, fs);
+#ifdef WITH_E2FSATTRS
+            unsigned long e2fs_flags;
+            if (e2fsattrs && (attr == 0 || attr&ATTR(attr_e2fsattrs))
+                    && get_e2fsattrs_from_statx(stx.stx_attributes_mask, stx.stx_attributes, conf->report_ignore_e2fsattrs, &e2fs_flags)) {
+                *e2fsattrs = e2fs_flags;
+            }
+#endif
+        }
+    } else
+#endif
+    sres = fstatat(dirfd, name, fs, AT_SYMLINK_NOFOLLOW);
     if(sres == -1){
         char* er = strerror(errno);
         if (er == NULL) {
-            log_msg(LOG_LEVEL_WARNING, "get_file_status: lstat() failed for %s. strerror() failed with %i", filename, errno);
+            log_msg(LOG_LEVEL_WARNING, "get_file_status: %s() failed for %s. strerror() failed with %i", function, filename, errno);
         } else {
-            log_msg(LOG_LEVEL_WARNING, "get_file_status: lstat() failed for %s: %s", filename, er);
+            log_msg(LOG_LEVEL_WARNING, "get_file_status: %s() failed for %s: %s", function, filename, er);
         }
     }
     return sres;
 }
 
-queue_ts_t *queue_worker_files = NULL;
+/*
+ * get_matched_file_status()
+ * get the attributes requested by the matching rule for a file whose type
+ * is known from readdir() (type_only is true), the status returned by
+ * get_file_status() is used as is (type_only is false)
+ */
+static int get_matched_file_status(int dirfd, const char *name, char *filename, DB_ATTR_TYPE attr, struct stat *fs, long *e2fsattrs, bool type_only) {
+    if (type_only) {
+        *e2fsattrs = -1;
+        mode_t type = fs->st_mode&S_IFMT;
+        if (get_file_status(dirfd, name, filename, attr, fs, e2fsattrs)) {
+            return -1;
+        }
+        if ((fs->st_mode&S_IFMT) != type) {
+            log_msg(LOG_LEVEL_WARNING, "get_file_status: file type of %s changed during scan (skip file)", filename);
+            return -1;
+        }
+    }
+    return 0;
+}
+
 queue_ts_t *queue_database_entries = NULL;
 
 pthread_t wait_for_workers_thread;
@@ -66,19 +197,56 @@ pthread_t *file_attributes_threads;
 
 const char *whoami_main = "(main)";
 
-static char *name_construct (const char *dirpath, const char *filename) {
-    int dirpath_len = strlen (dirpath);
-    int len = dirpath_len + strlen(filename) + (dirpath[dirpath_len-1] != '/'?1:0) + 1;
-    char *ret = checked_malloc(len);
-    snprintf(ret, len, "%s%s%s", dirpath, dirpath[dirpath_len-1] != '/'?"/":"", filename);
-    log_msg(LOG_LEVEL_TRACE,"name_construct: dir: '%s' (%p) + filename: '%s' (%p): '%s' (%p)", dirpath, (void*) dirpath, filename, (void*) filename, ret, (void*) ret);
-    return ret;
-}
+/* open directory shared by the scan queue and worker entries of its children */
+typedef struct scan_dir_fd {
+    int fd;
+    long refs;
+    pthread_mutex_t mutex;
+} scan_dir_fd;
+
+typedef struct scan_dir_item {
+    char *full_path;
+    scan_dir_fd *parent;
+    /* device of the parent directory (not set for the root directory) */
+    bool has_parent_dev;
+    dev_t parent_dev;
+} scan_dir_item;
+
+/* position on disk used by the hashsum scheduler (see hash_extent_order) */
+typedef struct sched_pos {
+    dev_t dev;
+    bool by_inode;
+    unsigned long long key;
+} sched_pos;
+
+/* files waiting for the workers are partitioned by device */
+typedef struct worker_device {
+    dev_t dev;
+    queue_ts_t *files;
+    long pending;
+    long active;
+    /* num_workers_per_device or device_num_workers limit, 0 means no limit */
+    long max_active;
+    /* files are handed over in one direction (C-SCAN), files found behind
+     * the position of the last handed over file are deferred to the next pass */
+    unsigned long sched_pass;
+    sched_pos sched_last;
+    /* next device in the same bucket of worker_devices_hash */
+    struct worker_device *hash_next;
+    /* ring of the devices with pending files (see worker_devices_pending) */
+    struct worker_device *pending_next;
+    struct worker_device *pending_prev;
+} worker_device;
 
 typedef struct scan_dir_entry {
     char *filename;
     DB_ATTR_TYPE attr;
     struct stat fs;
+    long e2fsattrs;
+    scan_dir_fd *dir;
+    worker_device *device;
+    unsigned long sched_pass;
+    sched_pos sched_pos;
 } scan_dir_entry;
 
 typedef struct database_entry {
@@ -86,7 +254,317 @@ typedef struct database_entry {
     struct stat fs;
 } database_entry;
 
-static void handle_matched_file(char *entry_full_path, DB_ATTR_TYPE attr, struct stat fs) {
+typedef struct scan_worker {
+    long index;
+    char whoami[32];
+    queue_ts_t *dirs;
+    pthread_t thread;
+    char *dirents_buf;
+} scan_worker;
+
+static scan_worker *scan_workers = NULL;
+static long num_scan_workers = 0;
+
+/* number of directories not yet processed completely / waiting in a scan queue */
+static long scan_dirs_pending = 0;
+static long scan_dirs_queued = 0;
+/* number of kept open directory file descriptors */
+static long scan_dir_fds_open = 0;
+static long scan_dir_fds_max = 0;
+static pthread_mutex_t scan_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t scan_cond = PTHREAD_COND_INITIALIZER;
+
+static scan_dir_fd *scan_dir_fd_new(int fd) {
+    scan_dir_fd *dir_fd = checked_malloc(sizeof(scan_dir_fd)); /* freed in scan_dir_fd_put */
+    dir_fd->fd = fd;
+    dir_fd->refs = 1;
+    pthread_mutex_init(&dir_fd->mutex, NULL);
+    return dir_fd;
+}
+
+static scan_dir_fd *scan_dir_fd_get(scan_dir_fd *dir_fd) {
+    if (dir_fd) {
+        pthread_mutex_lock(&dir_fd->mutex);
+        dir_fd->refs++;
+        pthread_mutex_unlock(&dir_fd->mutex);
+    }
+    return dir_fd;
+}
+
+static void scan_dir_fd_put(scan_dir_fd *dir_fd) {
+    if (dir_fd) {
+        pthread_mutex_lock(&dir_fd->mutex);
+        long refs = --dir_fd->refs;
+        pthread_mutex_unlock(&dir_fd->mutex);
+        if (refs == 0) {
+            if (dir_fd->fd >= 0) {
+                close(dir_fd->fd);
+                pthread_mutex_lock(&scan_mutex);
+                scan_dir_fds_open--;
+                pthread_mutex_unlock(&scan_mutex);
+            }
+            pthread_mutex_destroy(&dir_fd->mutex);
+            free(dir_fd);
+        }
+    }
+}
+
+/* returns AT_FDCWD if the entries have to be accessed by their full path */
+static int scan_dir_fd_fd(scan_dir_fd *dir_fd) {
+    return (dir_fd && dir_fd->fd >= 0) ? dir_fd->fd : AT_FDCWD;
+}
+
+static bool scan_dir_fd_reserve(void) {
+    pthread_mutex_lock(&scan_mutex);
+    bool reserved = scan_dir_fds_open < scan_dir_fds_max;
+    if (reserved) {
+        scan_dir_fds_open++;
+    }
+    pthread_mutex_unlock(&scan_mutex);
+    return reserved;
+}
+
+/* returns the maximum number of files opened by a worker at the same time */
+static long worker_open_files(void) {
+#ifdef WITH_URING
+    if (conf->io_uring) {
+        return URING_FILES;
+    }
+#endif
+    if (conf->multi_buffer_hashsums) {
+        return HW_HASH_MAX_LANES;
+    }
+    return 1;
+}
+
+static void scan_dir_fd_init_limit(void) {
+    struct rlimit rl;
+    /*
+     * file descriptors not available for kept open directories:
+     * - 64 for stdio, the databases, reports, log and config files and
+     *   descriptors opened by libraries
+     * - per worker the files being hashed (see worker_open_files())
+     * - 2 per scan worker: the directory being read and a file opened for
+     *   the 'hash_extent_order' option
+     */
+    rlim_t reserved = 64 + conf->num_workers * worker_open_files() + 2 * num_scan_workers;
+    scan_dir_fds_max = 0;
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0) {
+        if (rl.rlim_cur == RLIM_INFINITY) {
+            scan_dir_fds_max = 65536;
+        } else if (rl.rlim_cur > reserved) {
+            scan_dir_fds_max = rl.rlim_cur - reserved;
+        }
+    }
+    log_msg(LOG_LEVEL_DEBUG, "scan_dir: keep up to %ld directory file descriptors open", scan_dir_fds_max);
+}
+
+#define WORKER_DEVICES_HASH_SIZE 256
+
+static worker_device **worker_devices = NULL;
+static long num_worker_devices = 0;
+static worker_device *worker_devices_hash[WORKER_DEVICES_HASH_SIZE];
+/* device with pending files to start looking for files from (round-robin) */
+static worker_device *worker_devices_pending = NULL;
+static long worker_files_pending = 0;
+static bool worker_files_released = false;
+static pthread_mutex_t worker_files_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t worker_files_cond = PTHREAD_COND_INITIALIZER;
+
+static int compare_sched_pos(const sched_pos *a, const sched_pos *b) {
+    if (a->dev != b->dev) {
+        return a->dev < b->dev ? -1 : 1;
+    }
+    if (a->by_inode != b->by_inode) {
+        return a->by_inode ? 1 : -1;
+    }
+    if (a->key != b->key) {
+        return a->key < b->key ? -1 : 1;
+    }
+    return 0;
+}
+
+static int compare_scan_dir_entries(const void *a, const void *b) {
+    const scan_dir_entry *x = a;
+    const scan_dir_entry *y = b;
+    if (x->sched_pass != y->sched_pass) {
+        return x->sched_pass < y->sched_pass ? -1 : 1;
+    }
+    return compare_sched_pos(&x->sched_pos, &y->sched_pos);
+}
+
+static bool get_first_physical_block(int dirfd, const char *name, char *filename, unsigned long long *block) {
+#ifdef HAVE_LINUX_FIEMAP_H
+    int fd = open_file_at(dirfd, name, O_RDONLY|O_NOFOLLOW|O_NONBLOCK|O_NOCTTY|O_CLOEXEC);
+    if (fd < 0) {
+        log_msg(LOG_LEVEL_DEBUG, "hash_extent_order: open() failed for '%s': %s", filename, strerror(errno));
+        return false;
+    }
+    union {
+        struct fiemap fiemap;
+        char buf[sizeof(struct fiemap) + sizeof(struct fiemap_extent)];
+    } req;
+    memset(&req, 0, sizeof(req));
+    req.fiemap.fm_start = 0;
+    req.fiemap.fm_length = FIEMAP_MAX_OFFSET;
+    req.fiemap.fm_extent_count = 1;
+    bool found = false;
+    if (ioctl(fd, FS_IOC_FIEMAP, &req.fiemap) == -1) {
+        log_msg(LOG_LEVEL_DEBUG, "hash_extent_order: FIEMAP failed for '%s': %s", filename, strerror(errno));
+    } else if (req.fiemap.fm_mapped_extents > 0
+            && !(req.fiemap.fm_extents[0].fe_flags&(FIEMAP_EXTENT_UNKNOWN|FIEMAP_EXTENT_DELALLOC))) {
+        *block = req.fiemap.fm_extents[0].fe_physical;
+        found = true;
+    }
+    close(fd);
+    return found;
+#else
+    (void)dirfd; (void)name; (void)filename; (void)block;
+    return false;
+#endif
+}
+
+static void sched_set_position(scan_dir_entry *data) {
+    int dirfd = scan_dir_fd_fd(data->dir);
+    const char *name = dirfd == AT_FDCWD ? data->filename : strrchr(data->filename, '/') + 1;
+
+    data->sched_pos.dev = data->fs.st_dev;
+    data->sched_pos.by_inode = !(S_ISREG(data->fs.st_mode) && data->attr&get_hashes(true)
+            && get_first_physical_block(dirfd, name, data->filename, &data->sched_pos.key));
+    if (data->sched_pos.by_inode) {
+        data->sched_pos.key = data->fs.st_ino;
+    }
+}
+
+/* worker_files_mutex has to be locked */
+static worker_device *get_worker_device(dev_t dev) {
+    unsigned int bucket = (major(dev) * 31U + minor(dev)) % WORKER_DEVICES_HASH_SIZE;
+    for (worker_device *device = worker_devices_hash[bucket] ; device != NULL ; device = device->hash_next) {
+        if (device->dev == dev) {
+            return device;
+        }
+    }
+    worker_device *device = checked_malloc(sizeof(worker_device)); /* freed in wait_for_workers */
+    device->dev = dev;
+    device->hash_next = worker_devices_hash[bucket];
+    worker_devices_hash[bucket] = device;
+    device->pending_next = NULL;
+    device->pending_prev = NULL;
+    device->files = queue_init(conf->hash_extent_order ? compare_scan_dir_entries : NULL); /* freed in wait_for_workers */
+    device->pending = 0;
+    device->active = 0;
+    device->max_active = conf->num_workers_per_device;
+    for (list *l = conf->device_num_workers ; l != NULL ; l = l->next) {
+        device_num_workers *limit = l->data;
+        if (limit->resolved && limit->dev == dev) {
+            device->max_active = limit->num_workers;
+            break;
+        }
+    }
+    device->sched_pass = 0;
+    device->sched_last = (sched_pos) { dev, false, 0 };
+    worker_devices = checked_realloc(worker_devices, (num_worker_devices + 1) * sizeof(worker_device*)); /* freed in wait_for_workers */
+    worker_devices[num_worker_devices++] = device;
+    log_msg(LOG_LEVEL_DEBUG, "workers: add file queue for device %u:%u (max. active workers: %ld)", major(dev), minor(dev), device->max_active);
+    return device;
+}
+
+static void worker_files_enqueue(scan_dir_entry *data, const char *whoami) {
+    pthread_mutex_lock(&worker_files_mutex);
+    worker_device *device = get_worker_device(data->fs.st_dev);
+    data->device = device;
+    if (conf->hash_extent_order) {
+        data->sched_pass = compare_sched_pos(&data->sched_pos, &device->sched_last) < 0 ? device->sched_pass + 1 : device->sched_pass;
+        log_msg(LOG_LEVEL_TRACE, "hash_extent_order: schedule '%s' in pass %lu at %s %llu", data->filename, data->sched_pass, data->sched_pos.by_inode ? "inode" : "block", data->sched_pos.key);
+    }
+    queue_enqueue(device->files, data);
+    if (device->pending++ == 0) {
+        /* insert the device before the next one to look at (end of the ring) */
+        if (worker_devices_pending) {
+            device->pending_next = worker_devices_pending;
+            device->pending_prev = worker_devices_pending->pending_prev;
+            device->pending_prev->pending_next = device;
+            worker_devices_pending->pending_prev = device;
+        } else {
+            device->pending_next = device->pending_prev = device;
+            worker_devices_pending = device;
+        }
+    }
+    worker_files_pending++;
+    pthread_mutex_unlock(&worker_files_mutex);
+    log_msg(LOG_LEVEL_THREAD, "%10s: workers: added entry %p to file queue of device %u:%u", whoami, (void*) data, major(device->dev), minor(device->dev));
+    pthread_cond_signal(&worker_files_cond);
+}
+
+/*
+ * worker_files_dequeue()
+ * returns the next file of a device which has not reached its limit of
+ * active workers, NULL if there is none and wait is false or if all files
+ * are handed over and the scan is finished
+ */
+static scan_dir_entry *worker_files_dequeue(bool wait, const char *whoami) {
+    scan_dir_entry *data = NULL;
+    pthread_mutex_lock(&worker_files_mutex);
+    while (1) {
+        /* only devices with pending files are looked at */
+        worker_device *device = worker_devices_pending;
+        for (worker_device *first = device ; device != NULL ; ) {
+            if (device->max_active == 0 || device->active < device->max_active) {
+                data = queue_dequeue(device->files);
+                device->active++;
+                worker_files_pending--;
+                worker_devices_pending = device->pending_next;
+                if (--device->pending == 0) {
+                    if (device->pending_next == device) {
+                        worker_devices_pending = NULL;
+                    } else {
+                        device->pending_prev->pending_next = device->pending_next;
+                        device->pending_next->pending_prev = device->pending_prev;
+                    }
+                    device->pending_next = device->pending_prev = NULL;
+                }
+                if (conf->hash_extent_order) {
+                    if (data->sched_pass > device->sched_pass) {
+                        device->sched_pass = data->sched_pass;
+                    }
+                    device->sched_last = data->sched_pos;
+                }
+                break;
+            }
+            device = device->pending_next;
+            if (device == first) {
+                break;
+            }
+        }
+        if (data || !wait || (worker_files_released && worker_files_pending == 0)) {
+            break;
+        }
+        log_msg(LOG_LEVEL_THREAD, "%10s: workers: wait for files (pending: %ld)", whoami, worker_files_pending);
+        pthread_cond_wait(&worker_files_cond, &worker_files_mutex);
+    }
+    pthread_mutex_unlock(&worker_files_mutex);
+    return data;
+}
+
+static void worker_files_done(scan_dir_entry *data) {
+    pthread_mutex_lock(&worker_files_mutex);
+    data->device->active--;
+    pthread_mutex_unlock(&worker_files_mutex);
+    if (data->device->max_active) {
+        /* workers might wait for this device */
+        pthread_cond_broadcast(&worker_files_cond);
+    }
+}
+
+static void worker_files_release(const char *whoami) {
+    pthread_mutex_lock(&worker_files_mutex);
+    worker_files_released = true;
+    pthread_mutex_unlock(&worker_files_mutex);
+    log_msg(LOG_LEVEL_THREAD, "%10s: workers: release file queues and broadcast waiting threads", whoami);
+    pthread_cond_broadcast(&worker_files_cond);
+}
+
+static void handle_matched_file(char *entry_full_path, DB_ATTR_TYPE attr, struct stat fs, long e2fsattrs, scan_dir_fd *dir_fd, const char *whoami) {
     char *filename = checked_strdup(entry_full_path); /* not te be freed, reused as fullname in db_line */;
     if (conf->num_workers) {
         scan_dir_entry *data;
@@ -94,109 +572,575 @@ static void handle_matched_file(char *entry_full_path, DB_ATTR_TYPE attr, struct
         data->filename = filename;
         data->attr = attr;
         data->fs = fs;
-        log_msg(LOG_LEVEL_THREAD, "%10s: scan_dir: add entry %p to list of worker files (filename: '%s' (%p))", whoami_main,  (void*) data, data->filename, (void*) data->filename);
-        queue_ts_enqueue(queue_worker_files, data, whoami_main);
+        data->e2fsattrs = e2fsattrs;
+        data->dir = scan_dir_fd_get(dir_fd); /* released in file_attrs_worker */
+        if (conf->hash_extent_order) {
+            sched_set_position(data);
+        }
+        log_msg(LOG_LEVEL_THREAD, "%10s: scan_dir: add entry %p to list of worker files (filename: '%s' (%p))", whoami,  (void*) data, data->filename, (void*) data->filename);
+        worker_files_enqueue(data, whoami);
     } else {
-        db_line *line = get_file_attrs(filename, attr, &fs);
+        db_line *line = get_file_attrs(filename, attr, &fs, scan_dir_fd_fd(dir_fd), e2fsattrs, -1, NULL);
         add_file_to_tree(conf->tree, line, DB_NEW|DB_DISK, NULL, &fs);
     }
 }
 
-void scan_dir(char *root_path, bool dry_run) {
-    char* full_path;
+static void scan_dir_push(scan_worker *worker, char *full_path, scan_dir_fd *parent, const dev_t *parent_dev) {
+    scan_dir_item *item = checked_malloc(sizeof(scan_dir_item)); /* freed in scan_dir_worker */
+    item->full_path = checked_strdup(full_path); /* freed in scan_dir_worker */
+    item->parent = scan_dir_fd_get(parent); /* released in scan_directory */
+    item->has_parent_dev = parent_dev != NULL;
+    item->parent_dev = parent_dev ? *parent_dev : 0;
+    pthread_mutex_lock(&scan_mutex);
+    scan_dirs_pending++;
+    scan_dirs_queued++;
+    pthread_mutex_unlock(&scan_mutex);
+    queue_ts_enqueue(worker->dirs, item, worker->whoami);
+    if (num_scan_workers > 1) {
+        pthread_cond_broadcast(&scan_cond);
+    }
+}
+
+static scan_dir_item *scan_dir_pop(scan_worker *worker) {
+    /* the own queue is processed depth-first (most recently added directory
+     * first), so it stays short */
+    scan_dir_item *item = queue_ts_dequeue_tail(worker->dirs);
+    for (long i = 1; item == NULL && i < num_scan_workers; ++i) {
+        scan_worker *victim = &scan_workers[(worker->index + i) % num_scan_workers];
+        /* take the oldest directory (likely the root of a large subtree) from
+         * the other end of the queue */
+        item = queue_ts_dequeue(victim->dirs);
+        if (item) {
+            log_msg(LOG_LEVEL_THREAD, "%10s: scan_dir: took directory '%s' from scan queue of %s", worker->whoami, item->full_path, victim->whoami);
+        }
+    }
+    if (item) {
+        pthread_mutex_lock(&scan_mutex);
+        scan_dirs_queued--;
+        pthread_mutex_unlock(&scan_mutex);
+    }
+    return item;
+}
+
+static void scan_dir_done(void) {
+    pthread_mutex_lock(&scan_mutex);
+    bool finished = (--scan_dirs_pending == 0);
+    pthread_mutex_unlock(&scan_mutex);
+    if (finished && num_scan_workers > 1) {
+        pthread_cond_broadcast(&scan_cond);
+    }
+}
+
+static DIR *open_scan_dir(scan_dir_item *item, scan_dir_fd **dir_fd) {
+    char *full_path = item->full_path;
+    int parent_fd = scan_dir_fd_fd(item->parent);
+    const char *name = parent_fd == AT_FDCWD ? full_path : strrchr(full_path, '/')+1;
+
+    /* do not follow a directory replaced by a symlink after it has been stat'ed */
+    int fd = openat(parent_fd, name, O_RDONLY|O_DIRECTORY|O_CLOEXEC|(item->parent?O_NOFOLLOW:0));
+    scan_dir_fd_put(item->parent);
+    item->parent = NULL;
+    if (fd < 0) {
+        return NULL;
+    }
+
+    /* keep a duplicate of the descriptor open for the children of the directory */
+    int read_fd = -1;
+    if (scan_dir_fd_reserve()) {
+        read_fd = fcntl(fd, F_DUPFD_CLOEXEC, 0);
+        if (read_fd < 0) {
+            log_msg(LOG_LEVEL_DEBUG, "scan_dir: fcntl(F_DUPFD_CLOEXEC) failed for '%s': %s", full_path, strerror(errno));
+            pthread_mutex_lock(&scan_mutex);
+            scan_dir_fds_open--;
+            pthread_mutex_unlock(&scan_mutex);
+        }
+    }
+    if (read_fd < 0) {
+        log_msg(LOG_LEVEL_TRACE, "scan_dir: access children of '%s' by full path", full_path);
+        *dir_fd = scan_dir_fd_new(-1);
+        read_fd = fd;
+    } else {
+        *dir_fd = scan_dir_fd_new(fd);
+    }
+
+    DIR *dir = fdopendir(read_fd);
+    if (dir == NULL) {
+        int saved_errno = errno;
+        close(read_fd);
+        scan_dir_fd_put(*dir_fd);
+        *dir_fd = NULL;
+        errno = saved_errno;
+    }
+    return dir;
+}
+
+typedef struct scan_dir_ctx {
+    scan_worker *worker;
+    int fd;
+    scan_dir_fd *dir_fd;
+    /* device of the directory (only determined for mount boundary checks) */
+    bool dev_known;
+    dev_t dev;
+    /* full path of the current entry, only copied if needed */
+    char *path;
+    size_t path_size;
+    size_t dir_len;
+    bool dry_run;
+} scan_dir_ctx;
+
+static void scan_directory_entry(scan_dir_ctx *ctx, const char *name, unsigned char d_type) {
+    LOG_LEVEL log_level = LOG_LEVEL_TRACE;
     rx_rule *rule = NULL;
     seltree *node = NULL;
     struct stat fs;
 
+    size_t name_len = strlen(name);
+    if (ctx->dir_len + name_len + 1 > ctx->path_size) {
+        ctx->path_size = ctx->dir_len + name_len + 1;
+        ctx->path = checked_realloc(ctx->path, ctx->path_size);
+    }
+    memcpy(&ctx->path[ctx->dir_len], name, name_len + 1);
+    char *entry_full_path = ctx->path;
+
+    log_msg(log_level, "scan_dir: process child directory '%s' (fullpath: '%s')", &entry_full_path[conf->root_prefix_length], entry_full_path);
+    bool type_only = false;
+    int sres = 0;
+    long e2fsattrs = -1;
+    if (d_type != DT_UNKNOWN) {
+        /* rules are checked with the file type from the directory entry,
+         * non-matching entries are not stat'ed at all */
+        memset(&fs, 0, sizeof(struct stat));
+        fs.st_mode = DTTOIF(d_type);
+        type_only = true;
+    } else {
+        sres = get_file_status(ctx->fd, name, entry_full_path, 0, &fs, &e2fsattrs);
+    }
+    if (!sres) {
+        match_result match = check_rxtree (&entry_full_path[conf->root_prefix_length], conf->tree, &rule, get_restriction_from_perm(fs.st_mode), "disk");
+        switch (match) {
+            case RESULT_SELECTIVE_MATCH:
+            case RESULT_EQUAL_MATCH:
+                if (!ctx->dry_run) {
+                    mode_t type = fs.st_mode&S_IFMT;
+                    if (get_matched_file_status(ctx->fd, name, entry_full_path, rule->attr, &fs, &e2fsattrs, type_only)) {
+                        if (!S_ISDIR(type)) {
+                            break;
+                        }
+                        /* the failure has been logged, the children may still be readable */
+                        log_msg(LOG_LEVEL_DEBUG, "scan_dir: status of directory '%s' could not be read, scan its children anyway", &entry_full_path[conf->root_prefix_length]);
+                        fs.st_mode = type;
+                    } else {
+                        handle_matched_file(entry_full_path, rule->attr, fs, e2fsattrs, ctx->dir_fd, ctx->worker->whoami);
+                    }
+                }
+                if (S_ISDIR(fs.st_mode)) {
+                    log_msg(log_level, "scan_dir: add child directory '%s' to scan stack (reason: selective/equal match)", &entry_full_path[conf->root_prefix_length]);
+                    scan_dir_push(ctx->worker, entry_full_path, ctx->dir_fd, ctx->dev_known ? &ctx->dev : NULL);
+                }
+                break;
+            case RESULT_PARTIAL_MATCH:
+                if (S_ISDIR(fs.st_mode)) {
+                    log_msg(log_level, "scan_dir: add child directory '%s' to scan stack (reason: partial match)", &entry_full_path[conf->root_prefix_length]);
+                    scan_dir_push(ctx->worker, entry_full_path, ctx->dir_fd, ctx->dev_known ? &ctx->dev : NULL);
+                }
+                break;
+            case RESULT_NO_MATCH:
+                node = get_seltree_node(conf->tree, &entry_full_path[conf->root_prefix_length]);
+                if(S_ISDIR(fs.st_mode) && node) {
+                    log_msg(log_level, "scan_dir: add child directory '%s' to scan stack (reason: existing tree node %p)", &entry_full_path[conf->root_prefix_length], (void*) node);
+                    scan_dir_push(ctx->worker, entry_full_path, ctx->dir_fd, ctx->dev_known ? &ctx->dev : NULL);
+                }
+                break;
+            case RESULT_PARTIAL_LIMIT_MATCH:
+                if(S_ISDIR(fs.st_mode)) {
+                    log_msg(log_level, "scan_dir: add child directory '%s' to scan stack (reason: partial limit match", &entry_full_path[conf->root_prefix_length]);
+                    scan_dir_push(ctx->worker, entry_full_path, ctx->dir_fd, ctx->dev_known ? &ctx->dev : NULL);
+                }
+                break;
+            case RESULT_NO_LIMIT_MATCH:
+                break;
+        }
+        if (ctx->dry_run) {
+            print_match(&entry_full_path[conf->root_prefix_length], rule, match, get_restriction_from_perm(fs.st_mode));
+        }
+    }
+}
+
+static bool is_dot_entry(const char *name) {
+    return name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'));
+}
+
+typedef struct sorted_dirent {
+    ino_t ino;
+    size_t name;
+    unsigned char type;
+} sorted_dirent;
+
+typedef struct sorted_dirents {
+    sorted_dirent *entries;
+    size_t num;
+    size_t size;
+    /* entry names, referenced by offset */
+    char *names;
+    size_t names_len;
+    size_t names_size;
+} sorted_dirents;
+
+static void add_sorted_dirent(sorted_dirents *dirents, ino_t ino, const char *name, unsigned char type) {
+    size_t len = strlen(name) + 1;
+    if (dirents->num == dirents->size) {
+        dirents->size <<= 1;
+        dirents->entries = checked_realloc(dirents->entries, dirents->size * sizeof(sorted_dirent));
+    }
+    while (dirents->names_len + len > dirents->names_size) {
+        dirents->names_size <<= 1;
+        dirents->names = checked_realloc(dirents->names, dirents->names_size);
+    }
+    memcpy(&dirents->names[dirents->names_len], name, len);
+    dirents->entries[dirents->num].ino = ino;
+    dirents->entries[dirents->num].name = dirents->names_len;
+    dirents->entries[dirents->num].type = type;
+    dirents->names_len += len;
+    dirents->num++;
+}
+
+static int compare_sorted_dirents(const void *a, const void *b) {
+    ino_t ino_a = ((const sorted_dirent *) a)->ino;
+    ino_t ino_b = ((const sorted_dirent *) b)->ino;
+    return ino_a < ino_b ? -1 : ino_a > ino_b;
+}
+
+/* read all entries of a directory and sort them by inode number */
+static void read_sorted_dirents(scan_worker *worker, DIR *dir, sorted_dirents *dirents) {
+    dirents->num = 0;
+    dirents->size = 64;
+    dirents->entries = checked_malloc(dirents->size * sizeof(sorted_dirent)); /* freed in scan_directory */
+    dirents->names_len = 0;
+    dirents->names_size = 4096;
+    dirents->names = checked_malloc(dirents->names_size); /* freed in scan_directory */
+
+#ifdef HAVE_GETDENTS64
+    /* read the directory in large batches instead of using readdir()'s small buffer */
+    ssize_t nread;
+    if (worker->dirents_buf == NULL) {
+        worker->dirents_buf = checked_malloc(GETDENTS_BUFFER_SIZE); /* freed in scan_dir */
+    }
+    while ((nread = getdents64(dirfd(dir), worker->dirents_buf, GETDENTS_BUFFER_SIZE)) > 0) {
+        for (ssize_t pos = 0; pos < nread; ) {
+            struct dirent64 *entp = (struct dirent64 *) &worker->dirents_buf[pos];
+            if (!is_dot_entry(entp->d_name)) {
+                add_sorted_dirent(dirents, entp->d_ino, entp->d_name, entp->d_type);
+            }
+            pos += entp->d_reclen;
+        }
+    }
+    if (nread < 0) {
+        log_msg(LOG_LEVEL_WARNING, "scan_dir: getdents64() failed: %s", strerror(errno));
+    }
+#else
+    (void) worker;
+    struct dirent *entp;
+    while ((entp = readdir(dir)) != NULL) {
+        if (!is_dot_entry(entp->d_name)) {
+#ifdef HAVE_STRUCT_DIRENT_D_TYPE
+            add_sorted_dirent(dirents, entp->d_ino, entp->d_name, entp->d_type);
+#else
+            add_sorted_dirent(dirents, entp->d_ino, entp->d_name, DT_UNKNOWN);
+#endif
+        }
+    }
+#endif
+    qsort(dirents->entries, dirents->num, sizeof(sorted_dirent), compare_sorted_dirents);
+}
+
+#ifdef WITH_PSEUDO_FS_CHECK
+static const struct {
+    unsigned int magic;
+    const char *name;
+} pseudo_filesystems[] = {
+    { PROC_SUPER_MAGIC, "proc" },
+    { SYSFS_MAGIC, "sysfs" },
+    { DEVPTS_SUPER_MAGIC, "devpts" },
+#ifdef CGROUP_SUPER_MAGIC
+    { CGROUP_SUPER_MAGIC, "cgroup" },
+#endif
+#ifdef CGROUP2_SUPER_MAGIC
+    { CGROUP2_SUPER_MAGIC, "cgroup2" },
+#endif
+#ifdef DEBUGFS_MAGIC
+    { DEBUGFS_MAGIC, "debugfs" },
+#endif
+#ifdef TRACEFS_MAGIC
+    { TRACEFS_MAGIC, "tracefs" },
+#endif
+#ifdef SECURITYFS_MAGIC
+    { SECURITYFS_MAGIC, "securityfs" },
+#endif
+#ifdef SELINUX_MAGIC
+    { SELINUX_MAGIC, "selinuxfs" },
+#endif
+#ifdef SMACK_MAGIC
+    { SMACK_MAGIC, "smackfs" },
+#endif
+#ifdef BPF_FS_MAGIC
+    { BPF_FS_MAGIC, "bpf" },
+#endif
+#ifdef PSTOREFS_MAGIC
+    { PSTOREFS_MAGIC, "pstore" },
+#endif
+#ifdef EFIVARFS_MAGIC
+    { EFIVARFS_MAGIC, "efivarfs" },
+#endif
+#ifdef BINFMTFS_MAGIC
+    { BINFMTFS_MAGIC, "binfmt_misc" },
+#endif
+#ifdef NSFS_MAGIC
+    { NSFS_MAGIC, "nsfs" },
+#endif
+    { 0x62656570, "configfs" },
+    { 0x65735543, "fusectl" },
+    { 0x19800202, "mqueue" },
+};
+
+typedef struct scan_dir_mount {
+    dev_t dev;
+    const char *fs_name;
+} scan_dir_mount;
+
+/* result of the pseudo file system check per device */
+static scan_dir_mount *scan_dir_mounts = NULL;
+static long num_scan_dir_mounts = 0;
+
+static const char *get_pseudo_fs_name(int fd, const char *path) {
+    struct statfs sfs;
+    if (fstatfs(fd, &sfs) == -1) {
+        log_msg(LOG_LEVEL_DEBUG, "scan_dir: fstatfs() failed for '%s': %s", path, strerror(errno));
+        return NULL;
+    }
+    for (size_t i = 0 ; i < sizeof(pseudo_filesystems)/sizeof(pseudo_filesystems[0]) ; ++i) {
+        if ((unsigned int) sfs.f_type == pseudo_filesystems[i].magic) {
+            return pseudo_filesystems[i].name;
+        }
+    }
+    return NULL;
+}
+#endif
+
+/*
+ * scan_dir_skip_mount()
+ * called for directories on another device than their parent directory
+ */
+static bool scan_dir_skip_mount(int fd, dev_t dev, const char *path) {
+    if (conf->one_file_system) {
+        log_msg(LOG_LEVEL_INFO, "scan_dir: skip directory '%s' on other file system (device %u:%u)", path, major(dev), minor(dev));
+        return true;
+    }
+#ifdef WITH_PSEUDO_FS_CHECK
+    if (conf->skip_pseudo_filesystems) {
+        const char *fs_name = NULL;
+        bool checked = false;
+        pthread_mutex_lock(&scan_mutex);
+        for (long i = 0 ; i < num_scan_dir_mounts ; ++i) {
+            if (scan_dir_mounts[i].dev == dev) {
+                fs_name = scan_dir_mounts[i].fs_name;
+                checked = true;
+                break;
+            }
+        }
+        pthread_mutex_unlock(&scan_mutex);
+        if (!checked) {
+            fs_name = get_pseudo_fs_name(fd, path);
+            pthread_mutex_lock(&scan_mutex);
+            scan_dir_mounts = checked_realloc(scan_dir_mounts, (num_scan_dir_mounts + 1) * sizeof(scan_dir_mount)); /* freed in scan_dir */
+            scan_dir_mounts[num_scan_dir_mounts++] = (scan_dir_mount) { dev, fs_name };
+            pthread_mutex_unlock(&scan_mutex);
+        }
+        if (fs_name) {
+            log_msg(checked ? LOG_LEVEL_DEBUG : LOG_LEVEL_INFO, "scan_dir: skip directory '%s' on pseudo file system '%s'", path, fs_name);
+            return true;
+        }
+    }
+#else
+    (void)fd;
+#endif
+    return false;
+}
+
+static void scan_directory(scan_worker *worker, scan_dir_item *item, bool dry_run) {
+    DIR *dir;
+    scan_dir_fd *dir_fd = NULL;
+    char *full_path = item->full_path;
+    char *file_path = &full_path[conf->root_prefix_length];
+    log_msg(LOG_LEVEL_DEBUG,"scan_dir: process directory '%s' (fullpath: '%s')", file_path, full_path);
+    if((dir = open_scan_dir(item, &dir_fd)) == NULL) {
+        log_msg(LOG_LEVEL_WARNING,"opendir() failed for '%s' (fullpath: '%s'): %s", file_path, full_path, strerror(errno));
+        return;
+    }
+
+    scan_dir_ctx ctx;
+    ctx.dev_known = false;
+    if (conf->one_file_system || conf->skip_pseudo_filesystems) {
+        struct stat fs;
+        if (fstat(dirfd(dir), &fs) == -1) {
+            log_msg(LOG_LEVEL_DEBUG, "scan_dir: fstat() failed for '%s': %s", full_path, strerror(errno));
+        } else {
+            ctx.dev_known = true;
+            ctx.dev = fs.st_dev;
+            if (item->has_parent_dev && ctx.dev != item->parent_dev && scan_dir_skip_mount(dirfd(dir), ctx.dev, file_path)) {
+                closedir(dir);
+                scan_dir_fd_put(dir_fd);
+                return;
+            }
+        }
+    }
+
+    ctx.worker = worker;
+    ctx.fd = dirfd(dir);
+    ctx.dir_fd = dir_fd;
+    ctx.dry_run = dry_run;
+    ctx.dir_len = strlen(full_path);
+    /* room for the separator, the longest entry name and the terminating null byte */
+    ctx.path_size = ctx.dir_len + NAME_MAX + 2;
+    ctx.path = checked_malloc(ctx.path_size); /* freed below */
+    memcpy(ctx.path, full_path, ctx.dir_len);
+    if (ctx.dir_len == 0 || full_path[ctx.dir_len-1] != '/') {
+        ctx.path[ctx.dir_len++] = '/';
+    }
+    if (conf->scan_inode_order) {
+        sorted_dirents dirents;
+        read_sorted_dirents(worker, dir, &dirents);
+        log_msg(LOG_LEVEL_TRACE, "scan_dir: process %zu entries of '%s' in inode order", dirents.num, file_path);
+        for (size_t i = 0 ; i < dirents.num ; ++i) {
+            scan_directory_entry(&ctx, &dirents.names[dirents.entries[i].name], dirents.entries[i].type);
+        }
+        free(dirents.entries);
+        free(dirents.names);
+    } else {
+        struct dirent *entp;
+        while ((entp = readdir(dir)) != NULL) {
+            if (!is_dot_entry(entp->d_name)) {
+#ifdef HAVE_STRUCT_DIRENT_D_TYPE
+                scan_directory_entry(&ctx, entp->d_name, entp->d_type);
+#else
+                scan_directory_entry(&ctx, entp->d_name, DT_UNKNOWN);
+#endif
+            }
+        }
+    }
+    free(ctx.path);
+    closedir(dir);
+    scan_dir_fd_put(dir_fd);
+}
+
+static void scan_dir_worker(scan_worker *worker, bool dry_run) {
+    while (1) {
+        scan_dir_item *item = scan_dir_pop(worker);
+        if (item) {
+            scan_directory(worker, item, dry_run);
+            free(item->full_path);
+            free(item);
+            scan_dir_done();
+        } else {
+            pthread_mutex_lock(&scan_mutex);
+            while (scan_dirs_queued == 0 && scan_dirs_pending > 0) {
+                log_msg(LOG_LEVEL_THREAD, "%10s: scan_dir: wait for directories (pending: %ld)", worker->whoami, scan_dirs_pending);
+                pthread_cond_wait(&scan_cond, &scan_mutex);
+            }
+            bool finished = (scan_dirs_pending == 0);
+            pthread_mutex_unlock(&scan_mutex);
+            if (finished) {
+                log_msg(LOG_LEVEL_THREAD, "%10s: scan_dir: no more directories to scan", worker->whoami);
+                break;
+            }
+        }
+    }
+}
+
+static void * scan_dir_thread(void *arg) {
+    scan_worker *worker = arg;
+
+    mask_sig(worker->whoami);
+
+    log_msg(LOG_LEVEL_THREAD, "%10s: scan_dir: initialized scan worker thread #%ld", worker->whoami, worker->index);
+    scan_dir_worker(worker, false);
+
+    return (void *) pthread_self();
+}
+
+void scan_dir(char *root_path, bool dry_run) {
+    rx_rule *rule = NULL;
+    struct stat fs;
+
     log_msg(LOG_LEVEL_DEBUG,"scan_dir: process root directory '%s' (fullpath: '%s')", &root_path[conf->root_prefix_length], root_path);
-    if (!get_file_status(root_path, &fs)) {
+#ifdef HAVE_STATX
+    use_statx = statx(AT_FDCWD, root_path, AT_SYMLINK_NOFOLLOW, STATX_TYPE, &(struct statx) { 0 }) == 0 || errno != ENOSYS;
+    log_msg(LOG_LEVEL_DEBUG, "scan_dir: use statx(): %s", btoa(use_statx));
+    init_rules_statx_mask(conf->tree);
+    log_msg(LOG_LEVEL_DEBUG, "scan_dir: statx() mask for entries of unknown type: %#x", rules_statx_mask);
+#endif
+
+    long e2fsattrs;
+    if (!get_file_status(AT_FDCWD, root_path, root_path, 0, &fs, &e2fsattrs)) {
         match_result match = check_rxtree (&root_path[conf->root_prefix_length], conf->tree, &rule, get_restriction_from_perm(fs.st_mode), "disk");
         if (dry_run) {
             print_match(&root_path[conf->root_prefix_length], rule, match, get_restriction_from_perm(fs.st_mode));
         }
-        if (!dry_run && match&(RESULT_EQUAL_MATCH|RESULT_SELECTIVE_MATCH)) {
-            handle_matched_file(root_path, rule->attr, fs);
+        if (!dry_run && match&(RESULT_EQUAL_MATCH|RESULT_SELECTIVE_MATCH)
+                && !get_matched_file_status(AT_FDCWD, root_path, root_path, rule->attr, &fs, &e2fsattrs, false)) {
+            handle_matched_file(root_path, rule->attr, fs, e2fsattrs, NULL, whoami_main);
         }
     }
 
-    queue_ts_t *stack = queue_init(NULL);
-    log_msg(LOG_LEVEL_TRACE, "initialized scan stack queue %p", (void*) stack);
+    /* handle_matched_file() calls add_file_to_tree() directly without worker threads */
+    num_scan_workers = (dry_run || conf->num_workers == 0 || conf->num_scan_workers < 1) ? 1 : conf->num_scan_workers;
 
-    queue_enqueue(stack, checked_strdup(root_path)); /* freed below */
-
-    while((full_path = queue_dequeue(stack)) != NULL) {
-        DIR *dir;
-        char *file_path = &full_path[conf->root_prefix_length];
-        log_msg(LOG_LEVEL_DEBUG,"scan_dir: process directory '%s' (fullpath: '%s')", file_path, full_path);
-        if((dir = opendir(full_path)) == NULL) {
-            log_msg(LOG_LEVEL_WARNING,"opendir() failed for '%s' (fullpath: '%s'): %s", file_path, full_path, strerror(errno));
+    scan_workers = checked_malloc(num_scan_workers * sizeof(scan_worker)); /* freed below */
+    for (long i = 0 ; i < num_scan_workers ; ++i) {
+        scan_workers[i].index = i;
+        if (i) {
+            snprintf(scan_workers[i].whoami, 32, "(scan-%03li)", i);
         } else {
-            struct dirent *entp;
-            while ((entp = readdir(dir)) != NULL) {
-                LOG_LEVEL log_level = LOG_LEVEL_TRACE;
-                if (strcmp(entp->d_name, ".") != 0 && strcmp(entp->d_name, "..") != 0) {
-                    char *entry_full_path = name_construct(full_path, entp->d_name);
-                    bool free_entry_full_path = true;
-                    log_msg(log_level, "scan_dir: process child directory '%s' (fullpath: '%s')", &entry_full_path[conf->root_prefix_length], entry_full_path);
-                    if (!get_file_status(entry_full_path, &fs)) {
-                        rule = NULL;
-                        node = NULL;
-                        match_result match = check_rxtree (&entry_full_path[conf->root_prefix_length], conf->tree, &rule, get_restriction_from_perm(fs.st_mode), "disk");
-                        switch (match) {
-                            case RESULT_SELECTIVE_MATCH:
-                            case RESULT_EQUAL_MATCH:
-                                if (S_ISDIR(fs.st_mode)) {
-                                    log_msg(log_level, "scan_dir: add child directory '%s' to scan stack (reason: selective/equal match)", &entry_full_path[conf->root_prefix_length]);
-                                    queue_enqueue(stack, entry_full_path);
-                                    free_entry_full_path = false;
-                                }
-                                if (!dry_run) {
-                                    handle_matched_file(entry_full_path, rule->attr, fs);
-                                }
-                                break;
-                            case RESULT_PARTIAL_MATCH:
-                                if (S_ISDIR(fs.st_mode)) {
-                                    log_msg(log_level, "scan_dir: add child directory '%s' to scan stack (reason: partial match)", &entry_full_path[conf->root_prefix_length]);
-                                    queue_enqueue(stack, entry_full_path);
-                                    free_entry_full_path = false;
-                                }
-                                break;
-                            case RESULT_NO_MATCH:
-                                node = get_seltree_node(conf->tree, &entry_full_path[conf->root_prefix_length]);
-                                if(S_ISDIR(fs.st_mode) && node) {
-                                    log_msg(log_level, "scan_dir: add child directory '%s' to scan stack (reason: existing tree node %p)", &entry_full_path[conf->root_prefix_length], (void*) node);
-                                    free_entry_full_path = false;
-                                    queue_enqueue(stack, entry_full_path);
-                                }
-                                break;
-                            case RESULT_PARTIAL_LIMIT_MATCH:
-                                if(S_ISDIR(fs.st_mode)) {
-                                    log_msg(log_level, "scan_dir: add child directory '%s' to scan stack (reason: partial limit match", &entry_full_path[conf->root_prefix_length]);
-                                    queue_enqueue(stack, entry_full_path);
-                                    free_entry_full_path = false;
-                                }
-                                break;
-                            case RESULT_NO_LIMIT_MATCH:
-                                break;
-                        }
-                        if (dry_run) {
-                            print_match(&entry_full_path[conf->root_prefix_length], rule, match, get_restriction_from_perm(fs.st_mode));
-                        }
-                    }
-                    if (free_entry_full_path) {
-                        free(entry_full_path);
-                    }
-                }
-            }
-            closedir(dir);
+            snprintf(scan_workers[i].whoami, 32, "%s", whoami_main);
         }
-        free(full_path);
-        full_path = NULL;
+        scan_workers[i].dirs = queue_ts_init(NULL); /* freed below */
+        scan_workers[i].dirents_buf = NULL;
+        log_msg(LOG_LEVEL_TRACE, "initialized scan stack queue %p (%s)", (void*) scan_workers[i].dirs, scan_workers[i].whoami);
     }
+
+    scan_dir_fd_init_limit();
+
+    scan_dir_push(&scan_workers[0], root_path, NULL, NULL);
+
+    for (long i = 1 ; i < num_scan_workers ; ++i) {
+        if (pthread_create(&scan_workers[i].thread, NULL, &scan_dir_thread, &scan_workers[i]) != 0) {
+            log_msg(LOG_LEVEL_ERROR, "failed to start scan worker thread #%ld", i);
+            exit(THREAD_ERROR);
+        }
+    }
+
+    scan_dir_worker(&scan_workers[0], dry_run);
+
+    for (long i = 1 ; i < num_scan_workers ; ++i) {
+        if (pthread_join(scan_workers[i].thread, NULL) != 0) {
+            log_msg(LOG_LEVEL_WARNING, "failed to join scan worker thread #%ld", i);
+        }
+        log_msg(LOG_LEVEL_THREAD, "%10s: scan worker thread #%ld finished", whoami_main, i);
+    }
+
     if (conf->num_workers && !dry_run) {
-        queue_ts_release(queue_worker_files, whoami_main);
+        worker_files_release(whoami_main);
     }
-    queue_free(stack);
+    for (long i = 0 ; i < num_scan_workers ; ++i) {
+        queue_ts_free(scan_workers[i].dirs);
+        free(scan_workers[i].dirents_buf);
+    }
+    free(scan_workers);
+    scan_workers = NULL;
+#ifdef WITH_PSEUDO_FS_CHECK
+    free(scan_dir_mounts);
+    scan_dir_mounts = NULL;
+    num_scan_dir_mounts = 0;
+#endif
 }
 
 static void * add2tree( __attribute__((unused)) void *arg) {
@@ -243,6 +1187,118 @@ void db_scan_disk(bool dry_run) {
     free(full_path);
 }
 
+static void finish_worker_file(scan_dir_entry *data, int filedes, md_hashsums *md_hash, const char *whoami) {
+    db_line *line = get_file_attrs (data->filename, data->attr, &data->fs, scan_dir_fd_fd(data->dir), data->e2fsattrs, filedes, md_hash);
+    worker_files_done(data);
+    scan_dir_fd_put(data->dir);
+    database_entry *db_data;
+    db_data = checked_malloc(sizeof(database_entry)); /* freed in db_scan_disk */
+    db_data->line = line;
+    db_data->fs = data->fs;
+    log_msg(LOG_LEVEL_THREAD, "%10s: file_attrs_worker: add entry %p to list of database entries (filename: '%s')", whoami, (void*) line, line->filename);
+    queue_ts_enqueue(queue_database_entries, db_data, whoami);
+
+    free(data);
+}
+
+/*
+ * files whose hashsums are calculated by get_file_attrs() (see
+ * calc_file_hashsums()) instead of the io_uring and multi-buffer engines
+ */
+static bool hashed_by_get_file_attrs(scan_dir_entry *data) {
+    if (data->attr&(ATTR(attr_reuse)|ATTR(attr_sampled))) {
+        return true;
+    }
+#ifdef WITH_XXHASH
+    if (conf->xxh128_shortcut && conf->action&DO_COMPARE && data->attr&ATTR(attr_xxh128)
+            && data->attr&get_hashes(true)&~ATTR(attr_xxh128)) {
+        return true;
+    }
+#endif
+    return false;
+}
+
+#ifdef WITH_URING
+static void file_attrs_uring_worker(uring_engine *engine, const char *whoami) {
+    bool queue_done = false;
+    while (!queue_done || !uring_engine_empty(engine)) {
+        while (!queue_done && !uring_engine_full(engine)) {
+            scan_dir_entry *data;
+            /* only wait for new files if no I/O is pending */
+            if (uring_engine_empty(engine)) {
+                log_msg(LOG_LEVEL_THREAD, "%10s: file_attrs_worker: check/wait for files", whoami);
+                if ((data = worker_files_dequeue(true, whoami)) == NULL) {
+                    log_msg(LOG_LEVEL_THREAD, "%10s: file_attrs_worker: queue empty, exit thread", whoami);
+                    queue_done = true;
+                    break;
+                }
+            } else if ((data = worker_files_dequeue(false, whoami)) == NULL) {
+                break;
+            }
+            log_msg(LOG_LEVEL_THREAD, "%10s: file_attrs_workers: got entry %p from list of files (filename: '%s' (%p))", whoami, (void*) data, data->filename, (void*) data->filename);
+            /* the engine reads the holes of sparse files, calc_hashsums() skips them */
+            if (S_ISREG(data->fs.st_mode) && data->attr&get_hashes(true) && !hashed_by_get_file_attrs(data) && !hash_is_sparse(&data->fs)) {
+                int dirfd = scan_dir_fd_fd(data->dir);
+                const char *name = dirfd == AT_FDCWD ? data->filename : strrchr(data->filename, '/') + 1;
+                if (!uring_engine_add(engine, data, dirfd, name, data->filename, data->attr, &data->fs)) {
+                    finish_worker_file(data, -1, NULL, whoami);
+                }
+            } else {
+                finish_worker_file(data, -1, NULL, whoami);
+            }
+        }
+        if (!uring_engine_empty(engine)) {
+            int filedes;
+            md_hashsums md_hash;
+            scan_dir_entry *data = uring_engine_wait(engine, &filedes, &md_hash);
+            finish_worker_file(data, filedes, &md_hash, whoami);
+        }
+    }
+}
+#endif
+
+static bool multi_hash_file_eligible(scan_dir_entry *data) {
+    return S_ISREG(data->fs.st_mode) && data->fs.st_size <= MULTI_HASH_MAX_SIZE && data->attr&ATTR(attr_sha256)
+        && !(data->attr&ATTR(attr_growing)) && !hashed_by_get_file_attrs(data);
+}
+
+/*
+ * small files are collected until all SIMD lanes are used or no more files
+ * are queued, then they are hashed at once by calc_hashsums_multi()
+ */
+static void file_attrs_multi_hash_worker(int lanes, const char *whoami) {
+    scan_dir_entry *batch[HW_HASH_MAX_LANES];
+    multi_hash_file files[HW_HASH_MAX_LANES];
+    while (1) {
+        int n = 0;
+        scan_dir_entry *data;
+        /* only wait for new files if the batch is empty */
+        while (n < lanes && (data = worker_files_dequeue(n == 0, whoami)) != NULL) {
+            log_msg(LOG_LEVEL_THREAD, "%10s: file_attrs_workers: got entry %p from list of files (filename: '%s' (%p))", whoami, (void*) data, data->filename, (void*) data->filename);
+            if (multi_hash_file_eligible(data)) {
+                int dirfd = scan_dir_fd_fd(data->dir);
+                files[n].dirfd = dirfd;
+                files[n].name = dirfd == AT_FDCWD ? data->filename : strrchr(data->filename, '/') + 1;
+                files[n].fullpath = data->filename;
+                files[n].attr = data->attr;
+                files[n].old_fs = &data->fs;
+                batch[n++] = data;
+            } else {
+                finish_worker_file(data, -1, NULL, whoami);
+            }
+        }
+        if (n == 0) {
+            log_msg(LOG_LEVEL_THREAD, "%10s: file_attrs_worker: queue empty, exit thread", whoami);
+            break;
+        }
+        log_msg(LOG_LEVEL_THREAD, "%10s: file_attrs_worker: hash %d file(s) at once", whoami, n);
+        calc_hashsums_multi(files, n);
+        for (int i = 0 ; i < n ; ++i) {
+            finish_worker_file(batch[i], files[i].filedes, &files[i].md_hash, whoami);
+        }
+    }
+}
+
 static void * file_attrs_worker( __attribute__((unused)) void *arg) {
     long worker_index = (long) arg;
     char whoami[32];
@@ -252,21 +1308,30 @@ static void * file_attrs_worker( __attribute__((unused)) void *arg) {
 
     log_msg(LOG_LEVEL_THREAD, "%10s: file_attrs_worker: initialized worker thread #%ld", whoami, worker_index);
 
+    io_limit_set_worker_priority(whoami);
+
+#ifdef WITH_URING
+    if (conf->io_uring) {
+        uring_engine *engine = uring_engine_init(whoami);
+        if (engine) {
+            file_attrs_uring_worker(engine, whoami);
+            uring_engine_free(engine);
+            return (void *) pthread_self();
+        }
+    }
+#endif
+
+    if (conf->multi_buffer_hashsums) {
+        file_attrs_multi_hash_worker(hw_hash_multi_lanes(), whoami);
+        return (void *) pthread_self();
+    }
+
     while (1) {
         log_msg(LOG_LEVEL_THREAD, "%10s: file_attrs_worker: check/wait for files", whoami);
-        scan_dir_entry *data = queue_ts_dequeue_wait(queue_worker_files, whoami);
+        scan_dir_entry *data = worker_files_dequeue(true, whoami);
         if (data) {
             log_msg(LOG_LEVEL_THREAD, "%10s: file_attrs_workers: got entry %p from list of files (filename: '%s' (%p))", whoami, (void*) data, data->filename, (void*) data->filename);
-
-            db_line *line = get_file_attrs (data->filename, data->attr, &data->fs);
-            database_entry *db_data;
-            db_data = checked_malloc(sizeof(database_entry)); /* freed in db_scan_disk */
-            db_data->line = line;
-            db_data->fs = data->fs;
-            log_msg(LOG_LEVEL_THREAD, "%10s: file_attrs_worker: add entry %p to list of database entries (filename: '%s')", whoami, (void*) line, line->filename);
-            queue_ts_enqueue(queue_database_entries, db_data, whoami);
-
-            free(data);
+            finish_worker_file(data, -1, NULL, whoami);
         } else {
             log_msg(LOG_LEVEL_THREAD, "%10s: file_attrs_worker: queue empty, exit thread", whoami);
             break;
@@ -290,15 +1355,43 @@ static void * wait_for_workers( __attribute__((unused)) void *arg) {
     }
     free(file_attributes_threads);
     queue_ts_release(queue_database_entries, whoami);
-    queue_ts_free(queue_worker_files);
+    for (long i = 0 ; i < num_worker_devices ; ++i) {
+        queue_free(worker_devices[i]->files);
+        free(worker_devices[i]);
+    }
+    free(worker_devices);
+    worker_devices = NULL;
+    num_worker_devices = 0;
+    memset(worker_devices_hash, 0, sizeof(worker_devices_hash));
     return (void *) pthread_self();
 }
 
+/* device_num_workers entries given by path apply to the device of the path */
+static void resolve_device_num_workers(void) {
+    for (list *l = conf->device_num_workers ; l != NULL ; l = l->next) {
+        device_num_workers *limit = l->data;
+        if (limit->path == NULL) {
+            continue;
+        }
+        char *full_path = checked_malloc(conf->root_prefix_length + strlen(limit->path) + 1);
+        strcpy(full_path, conf->root_prefix);
+        strcat(full_path, limit->path);
+        struct stat fs;
+        if (stat(full_path, &fs) == 0) {
+            limit->dev = fs.st_dev;
+            limit->resolved = true;
+            log_msg(LOG_LEVEL_DEBUG, "workers: limit device %u:%u of '%s' to %ld active workers", major(fs.st_dev), minor(fs.st_dev), limit->path, limit->num_workers);
+        } else {
+            log_msg(LOG_LEVEL_WARNING, "workers: ignore device_num_workers limit for '%s': stat() failed: %s", full_path, strerror(errno));
+        }
+        free(full_path);
+    }
+}
+
 int db_disk_start_threads(void) {
+    resolve_device_num_workers();
     queue_database_entries = queue_ts_init(NULL); /* freed in add2tree */
     log_msg(LOG_LEVEL_THREAD, "%10s: initialized database entries queue %p", whoami_main, (void*) queue_database_entries);
-    queue_worker_files = queue_ts_init(NULL); /* freed in wait_for_workers */
-    log_msg(LOG_LEVEL_THREAD, "%10s: initialized worker files queue %p", whoami_main, (void*) queue_worker_files);
 
     file_attributes_threads = checked_malloc(conf->num_workers * sizeof(pthread_t)); /* freed in wait_for_workers */
 
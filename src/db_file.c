@@ -628,6 +628,10 @@ int db_writeline_file(db_line* line,db_config* dbconf, url_t* url){
     WRITE_HASHSUM(sha256)
     WRITE_HASHSUM(sha512)
     WRITE_HASHSUM(whirlpool)
+    WRITE_HASHSUM(merkle)
+    WRITE_HASHSUM(blake3)
+    WRITE_HASHSUM(xxh128)
+    WRITE_HASHSUM(sampled)
     case attr_attr : {
       db_write_attr(line->attr, dbconf->database_out.fp,i);
       break;
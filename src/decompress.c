@@ -0,0 +1,632 @@
+/*
+ * AIDE (Advanced Intrusion Detection Environment)
+ *
+ * Copyright (C) 2026 Hannes von Haugwitz
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "aide.h"
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/types.h>
+
+#ifdef WITH_ZLIB
+#include <zlib.h>
+#endif
+#ifdef WITH_ZSTD
+#include <zstd.h>
+#endif
+#ifdef WITH_LZMA
+#include <lzma.h>
+#endif
+#ifdef WITH_BZIP2
+#include <bzlib.h>
+#endif
+#ifdef WITH_LZ4
+#include <lz4frame.h>
+#endif
+
+#include "db_config.h"
+#include "decompress.h"
+#include "io_limit.h"
+#include "log.h"
+#include "util.h"
+
+#define DECOMPRESS_MAGIC_MAX 6
+#define DECOMPRESS_INPUT_SIZE 131072
+#define DECOMPRESS_BUFFER_SIZE 1048576
+/* compressed files from this size on are decompressed on a separate thread */
+#define DECOMPRESS_THREAD_MIN_SIZE 262144
+
+#define DECOMPRESS_FAILED(name, fullpath, error) \
+    log_msg(LOG_LEVEL_WARNING, "hash calculation: %s decompression failed for '%s': %s (uncompressed hashsums could not be calculated)", name, fullpath, error);
+
+/* compressed input of the stream decoders, the reads are accounted by the
+ * read rate limits (see io_limit.h) */
+typedef struct decompress_input {
+    int filedes;
+    dev_t dev;
+    unsigned char buf[DECOMPRESS_INPUT_SIZE];
+    size_t pos;
+    size_t len;
+    bool eof;
+} decompress_input;
+
+static void input_init(decompress_input *in, int filedes, dev_t dev) {
+    in->filedes = filedes;
+    in->dev = dev;
+    in->pos = 0;
+    in->len = 0;
+    in->eof = false;
+}
+
+/* refills an empty input buffer, returns -1 on error */
+static int input_fill(decompress_input *in, const char *fullpath) {
+    if (in->pos < in->len || in->eof) {
+        return 0;
+    }
+    ssize_t size = TEMP_FAILURE_RETRY(read(in->filedes, in->buf, DECOMPRESS_INPUT_SIZE));
+    if (size < 0) {
+        log_msg(LOG_LEVEL_WARNING, "hash calculation: read() failed for '%s': %s (uncompressed hashsums could not be calculated)", fullpath, strerror(errno));
+        return -1;
+    }
+    if (size > 0) {
+        io_limit_read(in->dev, size);
+    }
+    in->pos = 0;
+    in->len = size;
+    in->eof = size == 0;
+    return 0;
+}
+
+static bool input_empty(decompress_input *in) {
+    return in->eof && in->pos == in->len;
+}
+
+#ifdef WITH_ZLIB
+typedef struct gzip_state {
+    gzFile gzip;
+    int filedes;
+    dev_t dev;
+    /* compressed bytes accounted by the read rate limits */
+    off_t accounted;
+} gzip_state;
+
+static void *gzip_open(int filedes, const char *fullpath, dev_t dev) {
+    gzFile gzip = gzdopen(filedes, "rb");
+    if (gzip == NULL) {
+        log_msg(LOG_LEVEL_WARNING, "hash calculation: gzdopen() failed for %s (uncompressed hashsums could not be calculated)", fullpath);
+        return NULL;
+    }
+    gzip_state *state = checked_malloc(sizeof(gzip_state)); /* freed in gzip_close */
+    state->gzip = gzip;
+    state->filedes = filedes;
+    state->dev = dev;
+    state->accounted = 0;
+    return state;
+}
+
+static ssize_t gzip_read(void *arg, void *buf, size_t count, const char *fullpath) {
+    gzip_state *state = arg;
+    int size = gzread(state->gzip, buf, count);
+    /* zlib reads the compressed input itself, its file offset tells how much */
+    off_t offset = lseek(state->filedes, 0, SEEK_CUR);
+    if (offset > state->accounted) {
+        io_limit_read(state->dev, offset - state->accounted);
+        state->accounted = offset;
+    }
+    if (size <= 0) {
+        /* a truncated file ends without an error from gzread() */
+        int errnum;
+        const char *error = gzerror(state->gzip, &errnum);
+        if (size < 0 || errnum != Z_OK) {
+            DECOMPRESS_FAILED("gzip", fullpath, errnum == Z_ERRNO ? strerror(errno) : error)
+            return -1;
+        }
+    }
+    return size;
+}
+
+static int gzip_close(void *arg) {
+    gzip_state *state = arg;
+    int ret = gzclose(state->gzip);
+    free(state);
+    return ret;
+}
+#endif
+
+#ifdef WITH_ZSTD
+typedef struct zstd_state {
+    decompress_input in;
+    ZSTD_DCtx *dctx;
+    bool frame_done;
+} zstd_state;
+
+static void *zstd_open(int filedes, const char *fullpath, dev_t dev) {
+    ZSTD_DCtx *dctx = ZSTD_createDCtx();
+    if (dctx == NULL) {
+        DECOMPRESS_FAILED("zstd", fullpath, "ZSTD_createDCtx() failed")
+        return NULL;
+    }
+    zstd_state *state = checked_malloc(sizeof(zstd_state)); /* freed in zstd_close */
+    input_init(&state->in, filedes, dev);
+    state->dctx = dctx;
+    state->frame_done = false;
+    return state;
+}
+
+static ssize_t zstd_read(void *arg, void *buf, size_t count, const char *fullpath) {
+    zstd_state *state = arg;
+    ZSTD_outBuffer out = { buf, count, 0 };
+    while (out.pos < out.size) {
+        if (input_fill(&state->in, fullpath) < 0) {
+            return -1;
+        }
+        ZSTD_inBuffer in = { state->in.buf, state->in.len, state->in.pos };
+        size_t out_pos = out.pos;
+        size_t ret = ZSTD_decompressStream(state->dctx, &out, &in);
+        if (ZSTD_isError(ret)) {
+            DECOMPRESS_FAILED("zstd", fullpath, ZSTD_getErrorName(ret))
+            return -1;
+        }
+        if (in.pos == state->in.pos && out.pos == out_pos) {
+            /* end of input */
+            break;
+        }
+        state->in.pos = in.pos;
+        /* the input may consist of several frames */
+        state->frame_done = ret == 0;
+    }
+    if (out.pos == 0 && !state->frame_done) {
+        DECOMPRESS_FAILED("zstd", fullpath, "unexpected end of file")
+        return -1;
+    }
+    return out.pos;
+}
+
+static int zstd_close(void *arg) {
+    zstd_state *state = arg;
+    ZSTD_freeDCtx(state->dctx);
+    int ret = close(state->in.filedes);
+    free(state);
+    return ret;
+}
+#endif
+
+#ifdef WITH_LZMA
+typedef struct xz_state {
+    decompress_input in;
+    lzma_stream strm;
+    bool stream_end;
+} xz_state;
+
+static void *xz_open(int filedes, const char *fullpath, dev_t dev) {
+    xz_state *state = checked_malloc(sizeof(xz_state)); /* freed in xz_close */
+    input_init(&state->in, filedes, dev);
+    state->strm = (lzma_stream) LZMA_STREAM_INIT;
+    state->stream_end = false;
+    lzma_ret ret;
+#if LZMA_VERSION >= 50040002U
+    /* files with several blocks (e.g. compressed with 'xz -T0') are decoded
+     * in parallel, the CPU threads are divided among the workers */
+    long workers = conf->num_workers > 0 ? conf->num_workers : 1;
+    lzma_mt mt;
+    memset(&mt, 0, sizeof(mt));
+    mt.flags = LZMA_CONCATENATED;
+    mt.threads = lzma_cputhreads() / workers;
+    if (mt.threads < 1) {
+        mt.threads = 1;
+    }
+    mt.memlimit_threading = lzma_physmem() / 4 / workers;
+    mt.memlimit_stop = UINT64_MAX;
+    ret = lzma_stream_decoder_mt(&state->strm, &mt);
+#else
+    ret = lzma_stream_decoder(&state->strm, UINT64_MAX, LZMA_CONCATENATED);
+#endif
+    if (ret != LZMA_OK) {
+        DECOMPRESS_FAILED("xz", fullpath, "lzma_stream_decoder() failed")
+        free(state);
+        return NULL;
+    }
+    return state;
+}
+
+static ssize_t xz_read(void *arg, void *buf, size_t count, const char *fullpath) {
+    xz_state *state = arg;
+    state->strm.next_out = buf;
+    state->strm.avail_out = count;
+    while (state->strm.avail_out && !state->stream_end) {
+        if (input_fill(&state->in, fullpath) < 0) {
+            return -1;
+        }
+        state->strm.next_in = state->in.buf + state->in.pos;
+        state->strm.avail_in = state->in.len - state->in.pos;
+        lzma_ret ret = lzma_code(&state->strm, state->in.eof ? LZMA_FINISH : LZMA_RUN);
+        state->in.pos = state->in.len - state->strm.avail_in;
+        if (ret == LZMA_STREAM_END) {
+            state->stream_end = true;
+        } else if (ret != LZMA_OK) {
+            DECOMPRESS_FAILED("xz", fullpath, ret == LZMA_BUF_ERROR ? "unexpected end of file" : ret == LZMA_MEM_ERROR ? "out of memory" : "corrupt input")
+            return -1;
+        }
+    }
+    return count - state->strm.avail_out;
+}
+
+static int xz_close(void *arg) {
+    xz_state *state = arg;
+    lzma_end(&state->strm);
+    int ret = close(state->in.filedes);
+    free(state);
+    return ret;
+}
+#endif
+
+#ifdef WITH_BZIP2
+typedef struct bzip2_state {
+    decompress_input in;
+    bz_stream strm;
+    bool stream_end;
+} bzip2_state;
+
+static bool bzip2_init(bz_stream *strm) {
+    memset(strm, 0, sizeof(bz_stream));
+    return BZ2_bzDecompressInit(strm, 0, 0) == BZ_OK;
+}
+
+static void *bzip2_open(int filedes, const char *fullpath, dev_t dev) {
+    bzip2_state *state = checked_malloc(sizeof(bzip2_state)); /* freed in bzip2_close */
+    input_init(&state->in, filedes, dev);
+    state->stream_end = false;
+    if (!bzip2_init(&state->strm)) {
+        DECOMPRESS_FAILED("bzip2", fullpath, "BZ2_bzDecompressInit() failed")
+        free(state);
+        return NULL;
+    }
+    return state;
+}
+
+static ssize_t bzip2_read(void *arg, void *buf, size_t count, const char *fullpath) {
+    bzip2_state *state = arg;
+    state->strm.next_out = buf;
+    /* avail_out is an unsigned int */
+    state->strm.avail_out = count > DECOMPRESS_BUFFER_SIZE ? DECOMPRESS_BUFFER_SIZE : count;
+    unsigned int avail_out = state->strm.avail_out;
+    while (state->strm.avail_out) {
+        if (input_fill(&state->in, fullpath) < 0) {
+            return -1;
+        }
+        if (state->stream_end) {
+            /* the input may consist of several streams (e.g. compressed with pbzip2) */
+            if (input_empty(&state->in)) {
+                break;
+            }
+            BZ2_bzDecompressEnd(&state->strm);
+            char *next_out = state->strm.next_out;
+            unsigned int remaining = state->strm.avail_out;
+            if (!bzip2_init(&state->strm)) {
+                DECOMPRESS_FAILED("bzip2", fullpath, "BZ2_bzDecompressInit() failed")
+                return -1;
+            }
+            state->strm.next_out = next_out;
+            state->strm.avail_out = remaining;
+            state->stream_end = false;
+        }
+        if (input_empty(&state->in)) {
+            DECOMPRESS_FAILED("bzip2", fullpath, "unexpected end of file")
+            return -1;
+        }
+        state->strm.next_in = (char *) state->in.buf + state->in.pos;
+        state->strm.avail_in = state->in.len - state->in.pos;
+        int ret = BZ2_bzDecompress(&state->strm);
+        state->in.pos = state->in.len - state->strm.avail_in;
+        if (ret == BZ_STREAM_END) {
+            state->stream_end = true;
+        } else if (ret != BZ_OK) {
+            DECOMPRESS_FAILED("bzip2", fullpath, ret == BZ_MEM_ERROR ? "out of memory" : "corrupt input")
+            return -1;
+        }
+    }
+    return avail_out - state->strm.avail_out;
+}
+
+static int bzip2_close(void *arg) {
+    bzip2_state *state = arg;
+    BZ2_bzDecompressEnd(&state->strm);
+    int ret = close(state->in.filedes);
+    free(state);
+    return ret;
+}
+#endif
+
+#ifdef WITH_LZ4
+typedef struct lz4_state {
+    decompress_input in;
+    LZ4F_dctx *dctx;
+    bool frame_done;
+} lz4_state;
+
+static void *lz4_open(int filedes, const char *fullpath, dev_t dev) {
+    LZ4F_dctx *dctx;
+    LZ4F_errorCode_t ret = LZ4F_createDecompressionContext(&dctx, LZ4F_VERSION);
+    if (LZ4F_isError(ret)) {
+        DECOMPRESS_FAILED("lz4", fullpath, LZ4F_getErrorName(ret))
+        return NULL;
+    }
+    lz4_state *state = checked_malloc(sizeof(lz4_state)); /* freed in lz4_close */
+    input_init(&state->in, filedes, dev);
+    state->dctx = dctx;
+    state->frame_done = false;
+    return state;
+}
+
+static ssize_t lz4_read(void *arg, void *buf, size_t count, const char *fullpath) {
+    lz4_state *state = arg;
+    size_t out_pos = 0;
+    while (out_pos < count) {
+        if (input_fill(&state->in, fullpath) < 0) {
+            return -1;
+        }
+        size_t dst_size = count - out_pos;
+        size_t src_size = state->in.len - state->in.pos;
+        size_t ret = LZ4F_decompress(state->dctx, (char *) buf + out_pos, &dst_size, state->in.buf + state->in.pos, &src_size, NULL);
+        if (LZ4F_isError(ret)) {
+            DECOMPRESS_FAILED("lz4", fullpath, LZ4F_getErrorName(ret))
+            return -1;
+        }
+        if (src_size == 0 && dst_size == 0) {
+            /* end of input */
+            break;
+        }
+        state->in.pos += src_size;
+        out_pos += dst_size;
+        /* the input may consist of several frames */
+        state->frame_done = ret == 0;
+    }
+    if (out_pos == 0 && !state->frame_done) {
+        DECOMPRESS_FAILED("lz4", fullpath, "unexpected end of file")
+        return -1;
+    }
+    return out_pos;
+}
+
+static int lz4_close(void *arg) {
+    lz4_state *state = arg;
+    LZ4F_freeDecompressionContext(state->dctx);
+    int ret = close(state->in.filedes);
+    free(state);
+    return ret;
+}
+#endif
+
+typedef struct decompressor_backend {
+    const char *name;
+    const char *configure_option;
+    const char *magic;
+    size_t magic_length;
+    void *(*open)(int, const char *, dev_t);
+    ssize_t (*read)(void *, void *, size_t, const char *);
+    int (*close)(void *);
+} decompressor_backend;
+
+#define DECOMPRESSOR_BACKEND(name, option, magic, prefix) { name, option, magic, sizeof(magic) - 1, prefix##_open, prefix##_read, prefix##_close }
+#define DECOMPRESSOR_MISSING(name, option, magic) { name, option, magic, sizeof(magic) - 1, NULL, NULL, NULL }
+
+static const decompressor_backend backends[] = {
+#ifdef WITH_ZLIB
+    DECOMPRESSOR_BACKEND("gzip", "zlib", "\037\213", gzip),
+#else
+    DECOMPRESSOR_MISSING("gzip", "zlib", "\037\213"),
+#endif
+#ifdef WITH_ZSTD
+    DECOMPRESSOR_BACKEND("zstd", "zstd", "\050\265\057\375", zstd),
+#else
+    DECOMPRESSOR_MISSING("zstd", "zstd", "\050\265\057\375"),
+#endif
+#ifdef WITH_LZMA
+    DECOMPRESSOR_BACKEND("xz", "xz", "\3757zXZ\000", xz),
+#else
+    DECOMPRESSOR_MISSING("xz", "xz", "\3757zXZ\000"),
+#endif
+#ifdef WITH_BZIP2
+    DECOMPRESSOR_BACKEND("bzip2", "bzip2", "BZh", bzip2),
+#else
+    DECOMPRESSOR_MISSING("bzip2", "bzip2", "BZh"),
+#endif
+#ifdef WITH_LZ4
+    DECOMPRESSOR_BACKEND("lz4", "lz4", "\004\042\115\030", lz4),
+#else
+    DECOMPRESSOR_MISSING("lz4", "lz4", "\004\042\115\030"),
+#endif
+};
+
+/*
+ * Larger files are decompressed on a separate thread into two buffers, so
+ * the decompression of the next buffer overlaps with the hashing of the
+ * current one.
+ */
+
+struct decompressor {
+    const decompressor_backend *backend;
+    void *state;
+    const char *fullpath;
+
+    bool threaded;
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    char *bufs[2];
+    ssize_t lens[2];
+    bool filled[2];
+    bool stop;
+    int read_index;
+    ssize_t read_pos;
+};
+
+/* fills buf completely (unless the end is reached), returns -1 on error */
+static ssize_t decompress_fill(decompressor *d, char *buf, size_t count) {
+    size_t len = 0;
+    while (len < count) {
+        ssize_t size = d->backend->read(d->state, buf + len, count - len, d->fullpath);
+        if (size < 0) {
+            return -1;
+        } else if (size == 0) {
+            break;
+        }
+        len += size;
+    }
+    return len;
+}
+
+static void *decompress_thread(void *arg) {
+    decompressor *d = arg;
+    int index = 0;
+    while (true) {
+        pthread_mutex_lock(&d->mutex);
+        while (d->filled[index] && !d->stop) {
+            pthread_cond_wait(&d->cond, &d->mutex);
+        }
+        bool stop = d->stop;
+        pthread_mutex_unlock(&d->mutex);
+        if (stop) {
+            break;
+        }
+        ssize_t len = decompress_fill(d, d->bufs[index], DECOMPRESS_BUFFER_SIZE);
+        pthread_mutex_lock(&d->mutex);
+        d->lens[index] = len;
+        d->filled[index] = true;
+        pthread_cond_broadcast(&d->cond);
+        pthread_mutex_unlock(&d->mutex);
+        if (len <= 0) {
+            break;
+        }
+        index ^= 1;
+    }
+    return NULL;
+}
+
+static void decompress_start_thread(decompressor *d) {
+    d->bufs[0] = checked_malloc(DECOMPRESS_BUFFER_SIZE); /* freed in decompressor_close */
+    d->bufs[1] = checked_malloc(DECOMPRESS_BUFFER_SIZE); /* freed in decompressor_close */
+    d->filled[0] = d->filled[1] = false;
+    d->stop = false;
+    d->read_index = 0;
+    d->read_pos = 0;
+    pthread_mutex_init(&d->mutex, NULL);
+    pthread_cond_init(&d->cond, NULL);
+    int ret = pthread_create(&d->thread, NULL, decompress_thread, d);
+    if (ret != 0) {
+        log_msg(LOG_LEVEL_DEBUG, "%s> decompression: pthread_create() failed for '%s': %s (decompress on worker thread)", d->fullpath, d->fullpath, strerror(ret));
+        pthread_cond_destroy(&d->cond);
+        pthread_mutex_destroy(&d->mutex);
+        free(d->bufs[0]);
+        free(d->bufs[1]);
+        return;
+    }
+    d->threaded = true;
+}
+
+decompressor *decompressor_open(int filedes, const char *fullpath, off_t compressed_size, dev_t dev) {
+    unsigned char head[DECOMPRESS_MAGIC_MAX];
+    ssize_t head_length = 0;
+    ssize_t bytes = 0;
+    while (head_length < DECOMPRESS_MAGIC_MAX && (bytes = TEMP_FAILURE_RETRY(read(filedes, head + head_length, DECOMPRESS_MAGIC_MAX - head_length))) > 0) {
+        head_length += bytes;
+    }
+    if (bytes < 0 || lseek(filedes, 0, SEEK_SET) == -1) {
+        log_msg(LOG_LEVEL_WARNING, "hash calculation: failed to read magic bytes of '%s': %s (uncompressed hashsums could not be calculated)", fullpath, strerror(errno));
+        return NULL;
+    }
+    for (size_t i = 0 ; i < sizeof(backends)/sizeof(decompressor_backend) ; ++i) {
+        const decompressor_backend *backend = &backends[i];
+        if ((size_t) head_length >= backend->magic_length && memcmp(head, backend->magic, backend->magic_length) == 0) {
+            log_msg(LOG_LEVEL_COMPARE, "│ '%s' is %s compressed", fullpath, backend->name);
+            if (backend->open == NULL) {
+                log_msg(LOG_LEVEL_WARNING, "'%s': %s support not compiled in, recompile AIDE with '--with-%s' (uncompressed hashsums could not be calculated)", fullpath, backend->name, backend->configure_option);
+                return NULL;
+            }
+            void *state = backend->open(filedes, fullpath, dev);
+            if (state == NULL) {
+                return NULL;
+            }
+            decompressor *d = checked_malloc(sizeof(decompressor)); /* freed in decompressor_close */
+            d->backend = backend;
+            d->state = state;
+            d->fullpath = fullpath;
+            d->threaded = false;
+            if (compressed_size >= DECOMPRESS_THREAD_MIN_SIZE) {
+                decompress_start_thread(d);
+            }
+            return d;
+        }
+    }
+    log_msg(LOG_LEVEL_NOTICE, "'%s': no supported compression algorithm found (uncompressed hashsums could not be calculated)", fullpath);
+    return NULL;
+}
+
+ssize_t decompressor_read(decompressor *d, void *buf, size_t count) {
+    if (!d->threaded) {
+        return d->backend->read(d->state, buf, count, d->fullpath);
+    }
+    int index = d->read_index;
+    pthread_mutex_lock(&d->mutex);
+    while (!d->filled[index]) {
+        pthread_cond_wait(&d->cond, &d->mutex);
+    }
+    pthread_mutex_unlock(&d->mutex);
+    ssize_t len = d->lens[index];
+    if (len <= 0) {
+        /* end of file or error, the buffer stays filled */
+        return len;
+    }
+    size_t size = len - d->read_pos;
+    if (size > count) {
+        size = count;
+    }
+    memcpy(buf, d->bufs[index] + d->read_pos, size);
+    d->read_pos += size;
+    if (d->read_pos == len) {
+        pthread_mutex_lock(&d->mutex);
+        d->filled[index] = false;
+        pthread_cond_broadcast(&d->cond);
+        pthread_mutex_unlock(&d->mutex);
+        d->read_index ^= 1;
+        d->read_pos = 0;
+    }
+    return size;
+}
+
+int decompressor_close(decompressor *d) {
+    if (d->threaded) {
+        pthread_mutex_lock(&d->mutex);
+        d->stop = true;
+        pthread_cond_broadcast(&d->cond);
+        pthread_mutex_unlock(&d->mutex);
+        pthread_join(d->thread, NULL);
+        pthread_cond_destroy(&d->cond);
+        pthread_mutex_destroy(&d->mutex);
+        free(d->bufs[0]);
+        free(d->bufs[1]);
+    }
+    int ret = d->backend->close(d->state);
+    free(d);
+    return ret;
+}
@@ -33,12 +33,10 @@
 #include <fcntl.h>
 #include <unistd.h>
 #include <signal.h>
+#include <setjmp.h>
 #include <sys/mman.h>
 #include <sys/wait.h>
-
-#ifdef WITH_ZLIB
-#include <zlib.h>
-#endif
+#include <pthread.h>
 
 #ifdef WITH_XATTR
 #include <sys/xattr.h>
@@ -70,29 +68,28 @@
 
 #include "md.h"
 #include "do_md.h"
+#include "decompress.h"
 
 #include "hashsum.h"
+#include "io_limit.h"
 #include "db_line.h"
 #include "db_config.h"
 #include "util.h"
 #include "log.h"
 #include "attributes.h"
+#include "errorcodes.h"
 
 /* This define should be somewhere else */
 #define READ_BLOCK_SIZE 16777216
 
 typedef union fd {
     int plain;
-#ifdef WITH_ZLIB
-    gzFile gzip;
-#endif
+    decompressor *decompressor;
 } fd;
 
 typedef enum compression {
     COMPRESSION_PLAIN,
-#ifdef WITH_ZLIB
-    COMPRESSION_GZIP,
-#endif
+    COMPRESSION_DECOMPRESSOR,
     COMPRESSION_ERROR
 } compression;
 
@@ -123,36 +120,13 @@ int stat_cmp(struct stat* f1,struct stat* f2, bool growing) {
 	  stat_cmp_helper(st_dev,attr_dev));
 }
 
-static hashsums_file hashsum_open(int filedes, char* fullpath, bool uncompress) {
+static hashsums_file hashsum_open(int filedes, char* fullpath, struct stat *fs, bool uncompress) {
     hashsums_file file;
 
     if (uncompress) {
-        char head[2];
-        char *magic_gzip = "\037\213";
-        ssize_t magic_length = strlen(magic_gzip);
-        ssize_t bytes = read(filedes, head, magic_length);
-        if (bytes == magic_length && strncmp(head, magic_gzip, magic_length) == 0) {
-            log_msg(LOG_LEVEL_COMPARE, "│ '%s' is gzip compressed", fullpath);
-            lseek(filedes, 0, SEEK_SET);
-#ifdef WITH_ZLIB
-            file.fd.gzip = gzdopen(filedes, "rb");
-            if (file.fd.gzip == NULL){
-                log_msg(LOG_LEVEL_WARNING, "hash calculation: gzdopen() failed for %s (uncompressed hashsums could not be calculated)", fullpath);
-                file.compression = COMPRESSION_ERROR;
-                return file;
-            }
-            file.compression = COMPRESSION_GZIP;
-            return file;
-#else
-            log_msg(LOG_LEVEL_WARNING, "'%s': gzip support not compiled in, recompile AIDE with '--with-zlib' (uncompressed hashsums could not be calculated)", fullpath);
-            file.compression = COMPRESSION_ERROR;
-            return file;
-#endif
-        } else {
-            log_msg(LOG_LEVEL_NOTICE, "'%s': no supported compression algorithm found (uncompressed hashsums could not be calculated)", fullpath);
-            file.compression = COMPRESSION_ERROR;
-            return file;
-        }
+        file.fd.decompressor = decompressor_open(filedes, fullpath, fs->st_size, fs->st_dev);
+        file.compression = file.fd.decompressor == NULL ? COMPRESSION_ERROR : COMPRESSION_DECOMPRESSOR;
+        return file;
     } else {
         file.fd.plain = filedes;
         file.compression = COMPRESSION_PLAIN;
@@ -164,10 +138,8 @@ static size_t hashsum_read(hashsums_file file, void *buf, size_t count) {
     switch (file.compression) {
         case COMPRESSION_PLAIN:
              return read(file.fd.plain, buf, count);
-#ifdef WITH_ZLIB
-        case COMPRESSION_GZIP:
-             return gzread(file.fd.gzip, buf, count);
-#endif
+        case COMPRESSION_DECOMPRESSOR:
+             return decompressor_read(file.fd.decompressor, buf, count);
         case COMPRESSION_ERROR:
              return -1;
     }
@@ -178,32 +150,597 @@ static int hashsum_close(hashsums_file file) {
     switch (file.compression) {
         case COMPRESSION_PLAIN:
              return close(file.fd.plain);
-#ifdef WITH_ZLIB
-        case COMPRESSION_GZIP:
-             return gzclose(file.fd.gzip);
-#endif
+        case COMPRESSION_DECOMPRESSOR:
+             return decompressor_close(file.fd.decompressor);
         case COMPRESSION_ERROR:
              return -1;
     }
     return -1;
 }
 
-md_hashsums calc_hashsums(char* fullpath, DB_ATTR_TYPE attr, struct stat* old_fs, ssize_t limit_size, bool uncompress) {
+int open_file_at(int dirfd, const char *name, int flags) {
+    int filedes;
+#ifdef HAVE_O_NOATIME
+    filedes=openat(dirfd,name,flags|O_NOATIME);
+    if(filedes<0) {
+#endif
+        filedes=openat(dirfd,name,flags);
+#ifdef HAVE_O_NOATIME
+    }
+#endif
+    return filedes;
+}
+
+/*
+ * Per thread hash engine: the md containers are kept open and reset between
+ * files (one per set of requested hashsums), the page-aligned read buffer
+ * grows with the file sizes up to READ_BLOCK_SIZE. A container is reserved
+ * from hash_engine_get_md() until hash_engine_close_md(), so several files
+ * can be hashed at once by the same thread (see uring.c), at most
+ * HASH_ENGINE_CONTAINERS unused containers are kept open.
+ */
+
+#define HASH_ENGINE_CONTAINERS 4
+
+typedef struct hash_engine_md {
+    DB_ATTR_TYPE hashes;
+    struct md_container mdc;
+    unsigned long last_used;
+    bool in_use;
+} hash_engine_md;
+
+typedef struct hash_engine {
+    /* allocated one by one, an md container must not be moved (see md.h) */
+    hash_engine_md **mds;
+    int num_mds;
+    int num_unused;
+    unsigned long uses;
+    char *buf;
+    size_t buf_size;
+    char *multi_buf;
+} hash_engine;
+
+static pthread_key_t hash_engine_key;
+static pthread_once_t hash_engine_once = PTHREAD_ONCE_INIT;
+
+static void hash_engine_free(void *arg) {
+    hash_engine *engine = arg;
+    for (int i = 0 ; i < engine->num_mds ; ++i) {
+        free_md(&engine->mds[i]->mdc);
+        free(engine->mds[i]);
+    }
+    free(engine->mds);
+    free(engine->buf);
+    free(engine->multi_buf);
+    free(engine);
+}
+
+static void hash_engine_key_create(void) {
+    if (pthread_key_create(&hash_engine_key, hash_engine_free) != 0) {
+        log_msg(LOG_LEVEL_ERROR, "hash calculation: pthread_key_create() failed");
+        exit(THREAD_ERROR);
+    }
+}
+
+static hash_engine *get_hash_engine(void) {
+    pthread_once(&hash_engine_once, hash_engine_key_create);
+    hash_engine *engine = pthread_getspecific(hash_engine_key);
+    if (engine == NULL) {
+        engine = checked_malloc(sizeof(hash_engine)); /* freed in hash_engine_free */
+        memset(engine, 0, sizeof(hash_engine));
+        pthread_setspecific(hash_engine_key, engine);
+    }
+    return engine;
+}
+
+/* frees the container at index, only the pointers of the others are moved */
+static void hash_engine_remove_md(hash_engine *engine, int index) {
+    free_md(&engine->mds[index]->mdc);
+    free(engine->mds[index]);
+    engine->mds[index] = engine->mds[--engine->num_mds];
+}
+
+/* returns a reserved md container ready for update_md() or NULL on error */
+static struct md_container *hash_engine_get_md(hash_engine *engine, DB_ATTR_TYPE attr, const char *fullpath) {
+    DB_ATTR_TYPE hashes = attr&get_hashes(true);
+    hash_engine_md *md = NULL;
+    engine->uses++;
+    int index = -1;
+    for (int i = 0 ; i < engine->num_mds ; ++i) {
+        if (engine->mds[i]->in_use) {
+            continue;
+        }
+        if (engine->mds[i]->hashes == hashes) {
+            md = engine->mds[i];
+            if (reset_md(&md->mdc, fullpath) != RETOK) {
+                return NULL;
+            }
+            md->last_used = engine->uses;
+            md->in_use = true;
+            engine->num_unused--;
+            return &md->mdc;
+        }
+        if (md == NULL || engine->mds[i]->last_used < md->last_used) {
+            md = engine->mds[i];
+            index = i;
+        }
+    }
+    if (engine->num_unused < HASH_ENGINE_CONTAINERS) {
+        index = engine->num_mds++;
+        engine->mds = checked_realloc(engine->mds, engine->num_mds * sizeof(hash_engine_md*)); /* freed in hash_engine_free */
+        md = checked_malloc(sizeof(hash_engine_md)); /* freed in hash_engine_free */
+        engine->mds[index] = md;
+    } else {
+        /* replace least recently used unused container */
+        free_md(&md->mdc);
+        engine->num_unused--;
+    }
+    memset(md, 0, sizeof(hash_engine_md));
+    md->hashes = hashes;
+    md->last_used = engine->uses;
+    md->mdc.todo_attr = attr;
+    md->mdc.parallel = conf->parallel_hashsums;
+    if (init_md(&md->mdc, fullpath) != RETOK) {
+        hash_engine_remove_md(engine, index);
+        return NULL;
+    }
+    md->in_use = true;
+    return &md->mdc;
+}
+
+/* closes (see close_md()) and releases a container of hash_engine_get_md() */
+static void hash_engine_close_md(hash_engine *engine, struct md_container *mdc, md_hashsums *hs, const char *fullpath) {
+    close_md(mdc, hs, fullpath);
+    for (int i = 0 ; i < engine->num_mds ; ++i) {
+        if (&engine->mds[i]->mdc == mdc) {
+            if (engine->num_unused < HASH_ENGINE_CONTAINERS) {
+                engine->mds[i]->in_use = false;
+                engine->num_unused++;
+            } else {
+                hash_engine_remove_md(engine, i);
+            }
+            return;
+        }
+    }
+}
+
+struct md_container *hash_md_get(DB_ATTR_TYPE attr, const char *fullpath) {
+    return hash_engine_get_md(get_hash_engine(), attr, fullpath);
+}
+
+void hash_md_close(struct md_container *mdc, md_hashsums *hs, const char *fullpath) {
+    hash_engine_close_md(get_hash_engine(), mdc, hs, fullpath);
+}
+
+/* returns the read size for a file of the given size */
+static size_t hash_engine_buffer(hash_engine *engine, off_t file_size) {
+    size_t page_size = sysconf(_SC_PAGESIZE);
+    size_t size = READ_BLOCK_SIZE;
+    if (file_size >= 0 && (unsigned long long) file_size < READ_BLOCK_SIZE) {
+        /* read small files at once, the next read returns end of file */
+        size = ((file_size / page_size) + 1) * page_size;
+    }
+    if (size > engine->buf_size) {
+        size_t buf_size = engine->buf_size ? engine->buf_size : page_size;
+        while (buf_size < size) {
+            buf_size *= 2;
+        }
+        if (buf_size > READ_BLOCK_SIZE) {
+            buf_size = READ_BLOCK_SIZE;
+        }
+        free(engine->buf);
+        void *buf;
+        if (posix_memalign(&buf, page_size, buf_size) != 0) {
+            log_msg(LOG_LEVEL_ERROR, "hash calculation: posix_memalign() failed (size: %zu)", buf_size);
+            exit(MEMORY_ALLOCATION_FAILURE);
+        }
+        engine->buf = buf; /* freed in hash_engine_free */
+        engine->buf_size = buf_size;
+    }
+    return size < engine->buf_size ? size : engine->buf_size;
+}
+
+/*
+ * hash_readahead()
+ * starts the asynchronous read of the next window of a file (see
+ * 'hash_readahead' option), so the device is busy while the current window
+ * is hashed
+ */
+static void hash_readahead(int filedes, const char *fullpath, off_t offset, off_t len) {
+#ifdef HAVE_POSIX_FADVISE
+    /* read ahead data would not be accounted by the read rate limits and
+     * would be left in the page cache with 'hash_direct_io' */
+    if (conf->hash_readahead && len > 0 && !io_limit_enabled() && !conf->hash_direct_io) {
+        int ret = posix_fadvise(filedes, offset, len, POSIX_FADV_WILLNEED);
+        if (ret != 0) {
+            log_msg(LOG_LEVEL_DEBUG, "%s> hash calculation: posix_fadvise error for '%s': %s", fullpath, fullpath, strerror(ret));
+        }
+    }
+#endif
+}
+
+/*
+ * page cache neutral hashsum calculation (see 'hash_direct_io' option): plain
+ * files are read with O_DIRECT into the page-aligned buffer of the hash
+ * engine, so they bypass the page cache. If the file system refuses O_DIRECT
+ * the file is read buffered and the consumed windows are dropped from the
+ * page cache.
+ */
+
+/* returns true if O_DIRECT is set for filedes */
+static bool hash_direct_io_set(int filedes, const char *fullpath, bool enable) {
+#ifdef O_DIRECT
+    int flags = fcntl(filedes, F_GETFL);
+    if (flags == -1 || fcntl(filedes, F_SETFL, enable ? flags|O_DIRECT : flags&~O_DIRECT) == -1) {
+        log_msg(LOG_LEVEL_DEBUG, "%s> hash calculation: failed to %s O_DIRECT for '%s': %s", fullpath, enable ? "set" : "clear", fullpath, strerror(errno));
+        return !enable && flags != -1 && flags&O_DIRECT;
+    }
+    return enable;
+#else
+    (void)filedes; (void)fullpath; (void)enable;
+    return false;
+#endif
+}
+
+/* reads from a file with O_DIRECT set, falls back to buffered read() if the
+ * file system refuses the read (e.g. unaligned offset after a short read) */
+static ssize_t hash_direct_read(int filedes, const char *fullpath, void *buf, size_t count, bool *direct) {
+    ssize_t size = TEMP_FAILURE_RETRY(read(filedes, buf, count));
+    if (size == -1 && errno == EINVAL && *direct) {
+        log_msg(LOG_LEVEL_DEBUG, "%s> hash calculation: O_DIRECT read() refused for '%s' (fall back to buffered read())", fullpath, fullpath);
+        *direct = hash_direct_io_set(filedes, fullpath, false);
+        size = TEMP_FAILURE_RETRY(read(filedes, buf, count));
+    }
+    return size;
+}
+
+/*
+ * hash_drop_cache()
+ * drops the given range (len 0 means up to the end of the file) of a file read
+ * without O_DIRECT from the page cache (see 'hash_direct_io' option)
+ */
+void hash_drop_cache(int filedes, const char *fullpath, off_t offset, off_t len) {
+#ifdef HAVE_POSIX_FADVISE
+    if (conf->hash_direct_io) {
+        int ret = posix_fadvise(filedes, offset, len, POSIX_FADV_DONTNEED);
+        if (ret != 0) {
+            log_msg(LOG_LEVEL_DEBUG, "%s> hash calculation: posix_fadvise error for '%s': %s", fullpath, fullpath, strerror(ret));
+        }
+    }
+#else
+    (void)filedes; (void)fullpath; (void)offset; (void)len;
+#endif
+}
+
+/*
+ * mmap based hashsum calculation (see 'hash_mmap' option): large regular
+ * files are hashed directly from the page cache through read-only mappings
+ * of at most MMAP_WINDOW_SIZE bytes. Accessing a page beyond the end of a
+ * file truncated in the meantime raises SIGBUS, the handler jumps back into
+ * hash_mmap() of the faulting thread.
+ */
+
+#define MMAP_WINDOW_SIZE 67108864
+
+static __thread sigjmp_buf * volatile hash_mmap_jmp = NULL;
+static pthread_once_t hash_mmap_once = PTHREAD_ONCE_INIT;
+
+static void hash_mmap_sigbus_handler(int signum) {
+    if (hash_mmap_jmp != NULL) {
+        siglongjmp(*hash_mmap_jmp, 1);
+    }
+    /* not caused by a mapped file, fault again with the default action */
+    signal(signum, SIG_DFL);
+}
+
+static void hash_mmap_init(void) {
+    struct sigaction act;
+    memset(&act, 0, sizeof(act));
+    act.sa_handler = hash_mmap_sigbus_handler;
+    sigemptyset(&act.sa_mask);
+    if (sigaction(SIGBUS, &act, NULL) == -1) {
+        log_msg(LOG_LEVEL_WARNING, "hash calculation: failed to install SIGBUS handler: %s", strerror(errno));
+    }
+}
+
+/*
+ * hash_mmap()
+ * returns the number of bytes hashed, which is less than size if a mapping
+ * failed (the remaining bytes can be read) or the file was truncated
+ */
+static off_t hash_mmap(int filedes, const char *fullpath, struct md_container *mdc, off_t size, bool *truncated) {
+    pthread_once(&hash_mmap_once, hash_mmap_init);
+
+    sigjmp_buf jmp;
+    volatile off_t offset = 0;
+    char * volatile window = NULL;
+    volatile size_t window_size = 0;
+
+    *truncated = false;
+    if (sigsetjmp(jmp, 1) != 0) {
+        hash_mmap_jmp = NULL;
+        log_msg(LOG_LEVEL_DEBUG, "%s> hash calculation: SIGBUS while hashing mapping at offset %lld for '%s'", fullpath, (long long) offset, fullpath);
+        munmap(window, window_size);
+        *truncated = true;
+        return offset;
+    }
+    while (offset < size) {
+        window_size = size - offset < MMAP_WINDOW_SIZE ? size - offset : MMAP_WINDOW_SIZE;
+        void *addr = mmap(NULL, window_size, PROT_READ, MAP_SHARED, filedes, offset);
+        if (addr == MAP_FAILED) {
+            log_msg(LOG_LEVEL_DEBUG, "%s> hash calculation: mmap() failed at offset %lld for '%s': %s (fall back to read())", fullpath, (long long) offset, fullpath, strerror(errno));
+            break;
+        }
+        window = addr;
+        if (madvise(addr, window_size, MADV_SEQUENTIAL) == -1) {
+            log_msg(LOG_LEVEL_DEBUG, "%s> hash calculation: madvise() failed for '%s': %s", fullpath, fullpath, strerror(errno));
+        }
+        off_t next_offset = offset + window_size;
+        hash_readahead(filedes, fullpath, next_offset, size - next_offset < MMAP_WINDOW_SIZE ? size - next_offset : MMAP_WINDOW_SIZE);
+        hash_mmap_jmp = &jmp;
+        int ret = update_md(mdc, addr, window_size);
+        hash_mmap_jmp = NULL;
+        munmap(addr, window_size);
+        if (ret != RETOK) {
+            break;
+        }
+        offset += window_size;
+    }
+    return offset;
+}
+
+/*
+ * Sparse files: the holes (see SEEK_HOLE in lseek(2)) are not read but
+ * hashed from a buffer of zeros, only the data segments are read. Files
+ * with less than HASH_SPARSE_MIN_HOLES bytes of holes are read as usual.
+ */
+
+#define HASH_SPARSE_MIN_HOLES 16777216
+#define HASH_ZEROS_SIZE 1048576
+
+static char hash_zeros[HASH_ZEROS_SIZE];
+
+bool hash_is_sparse(struct stat *fs) {
+#if defined(SEEK_DATA) && defined(SEEK_HOLE)
+    return S_ISREG(fs->st_mode) && (long long) fs->st_blocks * 512 + HASH_SPARSE_MIN_HOLES <= (long long) fs->st_size;
+#else
+    (void)fs;
+    return false;
+#endif
+}
+
+/*
+ * hash_sparse()
+ * hashes the first size bytes of a sparse file, returns the number of bytes
+ * hashed, which is less than size if a system call or update_md() failed
+ * (the remaining bytes can be read) or the file was truncated
+ */
+static off_t hash_sparse(int filedes, const char *fullpath, struct md_container *mdc, char *buf, size_t read_size, off_t size, dev_t dev, bool *direct, bool *truncated) {
+    off_t offset = 0;
+    *truncated = false;
+#if defined(SEEK_DATA) && defined(SEEK_HOLE)
+    while (offset < size) {
+        off_t data = lseek(filedes, offset, SEEK_DATA);
+        if (data == -1) {
+            struct stat fs;
+            if (errno != ENXIO || fstat(filedes, &fs) == -1) {
+                log_msg(LOG_LEVEL_DEBUG, "%s> hash calculation: lseek(SEEK_DATA) failed at offset %lld for '%s': %s (fall back to read())", fullpath, (long long) offset, fullpath, strerror(errno));
+                break;
+            }
+            if (fs.st_size < size) {
+                *truncated = true;
+                break;
+            }
+            /* hole up to the end of the file */
+            data = size;
+        }
+        if (data > size) {
+            data = size;
+        }
+        while (offset < data) {
+            size_t len = data - offset < HASH_ZEROS_SIZE ? data - offset : HASH_ZEROS_SIZE;
+            if (update_md(mdc, hash_zeros, len) != RETOK) {
+                return offset;
+            }
+            offset += len;
+        }
+        if (offset == size) {
+            break;
+        }
+        off_t hole = lseek(filedes, offset, SEEK_HOLE);
+        if (hole == -1 || lseek(filedes, offset, SEEK_SET) == -1) {
+            log_msg(LOG_LEVEL_DEBUG, "%s> hash calculation: lseek() failed at offset %lld for '%s': %s (fall back to read())", fullpath, (long long) offset, fullpath, strerror(errno));
+            break;
+        }
+        if (hole > size) {
+            hole = size;
+        }
+        while (offset < hole) {
+            size_t len = hole - offset < (off_t) read_size ? (size_t) (hole - offset) : read_size;
+            ssize_t r = *direct ? hash_direct_read(filedes, fullpath, buf, len, direct) : TEMP_FAILURE_RETRY(read(filedes, buf, len));
+            if (r <= 0) {
+                /* the read loop of the caller reports the error */
+                return offset;
+            }
+            io_limit_read(dev, r);
+            if (!*direct) {
+                hash_drop_cache(filedes, fullpath, offset, r);
+            }
+            if (update_md(mdc, buf, r) != RETOK) {
+                return offset;
+            }
+            offset += r;
+        }
+    }
+#else
+    (void)filedes; (void)fullpath; (void)mdc; (void)buf; (void)read_size; (void)size; (void)dev; (void)direct;
+#endif
+    return offset;
+}
+
+/*
+ * Sampled hashsum: SHA-256 over a header (the hashed size, the window size
+ * and the number of windows as 64 bit big endian integers), the first and
+ * the last window of the file and 'sampled_hash_windows' windows evenly
+ * spaced in between (their offsets are aligned to HASH_SAMPLED_ALIGN).
+ * Files not larger than all windows together are hashed completely.
+ */
+
+#define HASH_SAMPLED_ALIGN 4096
+
+static bool sampled_hashsum_window(int filedes, const char *fullpath, struct md_container *mdc, char *buf, size_t read_size, off_t offset, off_t len, dev_t dev) {
+    while (len > 0) {
+        size_t count = len < (off_t) read_size ? (size_t) len : read_size;
+        ssize_t r = TEMP_FAILURE_RETRY(pread(filedes, buf, count, offset));
+        if (r <= 0) {
+            if (r == 0) {
+                log_msg(LOG_LEVEL_WARNING, "hash calculation: unexpected end of file at offset %lld for '%s', was file truncated while AIDE was running? (sampled hashsum could not be calculated)", (long long) offset, fullpath);
+            } else {
+                log_msg(LOG_LEVEL_WARNING, "hash calculation: pread() failed at offset %lld for '%s': %s (sampled hashsum could not be calculated)", (long long) offset, fullpath, strerror(errno));
+            }
+            return false;
+        }
+        io_limit_read(dev, r);
+        hash_drop_cache(filedes, fullpath, offset, r);
+        if (update_md(mdc, buf, r) != RETOK) {
+            log_msg(LOG_LEVEL_WARNING, "hash calculation: update_md() failed for '%s' (sampled hashsum could not be calculated)", fullpath);
+            return false;
+        }
+        offset += r;
+        len -= r;
+    }
+    return true;
+}
+
+/*
+ * sampled_hashsum()
+ * hashes the windows of the first size bytes of the file, returns true and
+ * writes the sampled hashsum to digest on success
+ */
+static bool sampled_hashsum(int filedes, const char *fullpath, char *buf, size_t read_size, off_t size, dev_t dev, unsigned char *digest) {
+    off_t window = conf->sampled_hash_size;
+    long windows = conf->sampled_hash_windows;
+
+    struct md_container mdc;
+    memset(&mdc, 0, sizeof(mdc));
+    mdc.todo_attr = ATTR(attr_sha256);
+    if (init_md(&mdc, fullpath) != RETOK) {
+        log_msg(LOG_LEVEL_WARNING, "hash calculation: init_md() failed for '%s' (sampled hashsum could not be calculated)", fullpath);
+        return false;
+    }
+    /* init_md() has logged the failed initialisation of the SHA-256 hash */
+    bool ok = (mdc.calc_attr|mdc.hw_attr)&ATTR(attr_sha256);
+
+    unsigned char header[24];
+    unsigned long long values[] = { size, window, windows };
+    for (int i = 0 ; i < 3 ; ++i) {
+        for (int j = 0 ; j < 8 ; ++j) {
+            header[i * 8 + j] = values[i] >> (56 - 8 * j);
+        }
+    }
+    ok = ok && update_md(&mdc, header, sizeof(header)) == RETOK;
+
+    if (size <= (windows + 2) * window) {
+        log_msg(LOG_LEVEL_DEBUG, "%s> sampled hashsum: hash all %lld bytes of '%s'", fullpath, (long long) size, fullpath);
+        ok = ok && sampled_hashsum_window(filedes, fullpath, &mdc, buf, read_size, 0, size, dev);
+    } else {
+        log_msg(LOG_LEVEL_DEBUG, "%s> sampled hashsum: hash %ld+2 windows of %lld bytes of '%s' (size: %lld bytes)", fullpath, windows, (long long) window, fullpath, (long long) size);
+        ok = ok && sampled_hashsum_window(filedes, fullpath, &mdc, buf, read_size, 0, window, dev);
+        /* the windows split the bytes between the first and the last window evenly */
+        off_t step = (size - 3 * window) / (windows + 1);
+        for (long i = 1 ; ok && i <= windows ; ++i) {
+            off_t offset = window + step * i;
+            offset -= offset % HASH_SAMPLED_ALIGN;
+            ok = sampled_hashsum_window(filedes, fullpath, &mdc, buf, read_size, offset, window, dev);
+        }
+        ok = ok && sampled_hashsum_window(filedes, fullpath, &mdc, buf, read_size, size - window, window, dev);
+    }
+
+    md_hashsums hs;
+    close_md(&mdc, ok ? &hs : NULL, fullpath);
+    free_md(&mdc);
+    if (ok) {
+        memcpy(digest, hs.hashsums[hash_sha256], hashsums[hash_sampled].length);
+    }
+    return ok;
+}
+
+/*
+ * hashsum_check_stat()
+ * new_fs: status of the file opened for hashsum calculation
+ * returns RETOK if the file has not been changed since old_fs was read
+ */
+int hashsum_check_stat(char* fullpath, DB_ATTR_TYPE attr, struct stat* new_fs, struct stat* old_fs) {
+    int stat_diff;
+    if(!(attr&ATTR(attr_rdev))) {
+        new_fs->st_rdev=0;
+    }
+    if ((stat_diff=stat_cmp(new_fs, old_fs, attr&ATTR(attr_growing))) != RETOK) {
+        DB_ATTR_TYPE changed_attribures = 0ULL;
+        for(ATTRIBUTE i=0;i<num_attrs;i++) {
+            if (((1<<i)&stat_diff)!=0) {
+                changed_attribures |= 1<<i;
+            }
+        }
+        char *str;
+        log_msg(LOG_LEVEL_WARNING, "hash calculation: '%s' has been changed (changed attributes: %s, hash could not be calculated)", fullpath, str = diff_attributes(0, changed_attribures));
+        free(str);
+        return RETFAIL;
+    }
+    return RETOK;
+}
+
+/*
+ * hashsum_check_size()
+ * r_size: number of bytes read from the (uncompressed) file
+ * returns RETOK if r_size matches the stat or limited size
+ */
+int hashsum_check_size(char* fullpath, DB_ATTR_TYPE attr, struct stat* old_fs, ssize_t limit_size, off_t r_size) {
+    bool mismatch = false;
+    bool lower = false;
+    long long target_size = old_fs->st_size;
+    if (limit_size > 0) {
+        if (r_size < limit_size) {
+            target_size = limit_size;
+            lower = true;
+            mismatch = true;
+        }
+    } else if (attr&ATTR(attr_growing)) {
+        if (r_size < old_fs->st_size) {
+            lower = true;
+            mismatch = true;
+        }
+    } else {
+        if (r_size != old_fs->st_size) {
+            lower = r_size<old_fs->st_size;
+            mismatch = true;
+        }
+    }
+    if (mismatch) {
+        log_msg(LOG_LEVEL_WARNING, "hash calculation: number of bytes read (%lld) mismatches %s size (%lld) for '%s'%s (hashsums could not be calculated)",
+                (long long) r_size, limit_size > 0?"limited":"stat", target_size, fullpath,
+                lower?", was file truncated while AIDE was running?":", was file growing while AIDE was running? (consider adding 'growing' attribute)"
+               );
+        return RETFAIL;
+    }
+    return RETOK;
+}
+
+/*
+ * calc_hashsums()
+ * filedes: file descriptor of fullpath opened for reading or -1 to open
+ * fullpath, the file descriptor is closed by calc_hashsums
+ */
+md_hashsums calc_hashsums(int filedes, char* fullpath, DB_ATTR_TYPE attr, struct stat* old_fs, ssize_t limit_size, bool uncompress) {
     md_hashsums md_hash;
     md_hash.attrs = 0LU;
 
         struct stat new_fs;
         int sres=0;
-        int stat_diff,filedes;
 
-#ifdef HAVE_O_NOATIME
-        filedes=open(fullpath,O_RDONLY|O_NOATIME);
-        if(filedes<0) {
-#endif
-            filedes=open(fullpath,O_RDONLY);
-#ifdef HAVE_O_NOATIME
+        if (filedes < 0) {
+            filedes=open_file_at(AT_FDCWD,fullpath,O_RDONLY);
         }
-#endif
         if (filedes==-1) {
             log_msg(LOG_LEVEL_WARNING, "hash calculation: open() failed for %s: %s (hashsums could not be calculated)", fullpath, strerror(errno));
             return md_hash;
@@ -211,30 +748,19 @@ md_hashsums calc_hashsums(char* fullpath, DB_ATTR_TYPE attr, struct stat* old_fs
         sres=fstat(filedes,&new_fs);
         if (sres != 0) {
             log_msg(LOG_LEVEL_WARNING, "hash calculation: fstat() failed for '%s': %s (hashsums could not be calculated)", fullpath, strerror(errno));
+            close(filedes);
             return md_hash;
         }
-        if(!(attr&ATTR(attr_rdev))) {
-            new_fs.st_rdev=0;
-        }
 #ifdef HAVE_POSIX_FADVISE
         if (posix_fadvise(filedes,0,new_fs.st_size,POSIX_FADV_NOREUSE)!=0) {
             log_msg(LOG_LEVEL_DEBUG, "%s> calc_hashsums: posix_fadvise error for '%s': %s", fullpath, fullpath, strerror(errno));
         }
 #endif
-        if ((stat_diff=stat_cmp(&new_fs, old_fs, attr&ATTR(attr_growing))) != RETOK) {
-            DB_ATTR_TYPE changed_attribures = 0ULL;
-            for(ATTRIBUTE i=0;i<num_attrs;i++) {
-                if (((1<<i)&stat_diff)!=0) {
-                    changed_attribures |= 1<<i;
-                }
-            }
-            char *str;
-            log_msg(LOG_LEVEL_WARNING, "hash calculation: '%s' has been changed (changed attributes: %s, hash could not be calculated)", fullpath, str = diff_attributes(0, changed_attribures));
-            free(str);
+        if (hashsum_check_stat(fullpath, attr, &new_fs, old_fs) != RETOK) {
             close(filedes);
             return md_hash;
         } else {
-            hashsums_file file = hashsum_open(filedes, fullpath, uncompress);
+            hashsums_file file = hashsum_open(filedes, fullpath, &new_fs, uncompress);
             if (file.compression == COMPRESSION_ERROR) {
                 close(filedes);
                 return md_hash;
@@ -244,15 +770,75 @@ md_hashsums calc_hashsums(char* fullpath, DB_ATTR_TYPE attr, struct stat* old_fs
             off_t size=0;
             char* buf;
 
-            struct md_container mdc;
-            mdc.todo_attr = attr;
-            if (init_md(&mdc, fullpath)==RETOK) {
+            hash_engine *engine = get_hash_engine();
+            off_t hash_size = attr&ATTR(attr_growing) ? old_fs->st_size : new_fs.st_size;
+            if (limit_size > 0 && limit_size < hash_size) {
+                hash_size = limit_size;
+            }
+            md_hashsums sampled_hash;
+            sampled_hash.attrs = 0LLU;
+            if (attr&ATTR(attr_sampled) && !uncompress) {
+                size_t sampled_read_size = hash_engine_buffer(engine, new_fs.st_size);
+                if (!sampled_hashsum(file.fd.plain, fullpath, engine->buf, sampled_read_size, hash_size, new_fs.st_dev, sampled_hash.hashsums[hash_sampled])) {
+                    hashsum_close(file);
+                    return md_hash;
+                }
+                sampled_hash.attrs = ATTR(attr_sampled);
+                if (!(attr&get_hashes(true)&~ATTR(attr_sampled))) {
+                    /* no other hashsums requested, the file is not read completely */
+                    struct stat fs;
+                    if (fstat(file.fd.plain, &fs) != 0) {
+                        log_msg(LOG_LEVEL_WARNING, "hash calculation: fstat() failed for '%s': %s (hashsums could not be calculated)", fullpath, strerror(errno));
+                    } else if (hashsum_check_size(fullpath, attr, old_fs, limit_size, fs.st_size) == RETOK) {
+                        md_hash = sampled_hash;
+                    }
+                    hashsum_close(file);
+                    return md_hash;
+                }
+            }
+            /* the sampled hashsum is not calculated from the (decompressed) data stream */
+            attr &= ~ATTR(attr_sampled);
+            struct md_container *mdc = hash_engine_get_md(engine, attr, fullpath);
+            if (mdc != NULL) {
                 log_msg(LOG_LEVEL_DEBUG, "%s> calculate hashes for '%s'", fullpath, fullpath);
-                buf=checked_malloc(READ_BLOCK_SIZE);
 #if READ_BLOCK_SIZE>SSIZE_MAX
 #error "READ_BLOCK_SIZE" is too large. Max value is SSIZE_MAX, and current is READ_BLOCK_SIZE
 #endif
-                while ((size=TEMP_FAILURE_RETRY(hashsum_read(file,buf,READ_BLOCK_SIZE)))>0) {
+                /* the uncompressed size is unknown */
+                size_t read_size = hash_engine_buffer(engine, uncompress ? -1 : new_fs.st_size);
+                buf = engine->buf;
+                bool truncated = false;
+                bool direct = conf->hash_direct_io && file.compression == COMPRESSION_PLAIN && hash_direct_io_set(file.fd.plain, fullpath, true);
+                bool sparse = file.compression == COMPRESSION_PLAIN && hash_is_sparse(&new_fs);
+                if (sparse) {
+                    log_msg(LOG_LEVEL_DEBUG, "%s> hash calculation: '%s' is sparse (allocated: %lld bytes, size: %lld bytes)", fullpath, fullpath, (long long) new_fs.st_blocks * 512, (long long) new_fs.st_size);
+                    r_size = hash_sparse(file.fd.plain, fullpath, mdc, buf, read_size, hash_size, new_fs.st_dev, &direct, &truncated);
+                } else if (conf->hash_mmap && file.compression == COMPRESSION_PLAIN && new_fs.st_size > READ_BLOCK_SIZE && !io_limit_enabled() && !conf->hash_direct_io
+                        /* SIGBUS on a helper thread can not be caught by hash_mmap() */
+                        && !mdc->parallel) {
+                    r_size = hash_mmap(file.fd.plain, fullpath, mdc, hash_size, &truncated);
+                }
+                /* the remaining bytes (if any) are read, hash_sparse() may have moved the file offset */
+                if (!truncated && (sparse || r_size > 0) && lseek(filedes, r_size, SEEK_SET) == -1) {
+                    log_msg(LOG_LEVEL_WARNING, "hash calculation: lseek() failed for '%s': %s (hashsums could not be calculated)", fullpath, strerror(errno));
+                    hashsum_close(file);
+                    hash_engine_close_md(engine, mdc, NULL, fullpath);
+                    return md_hash;
+                }
+                off_t read_offset = r_size;
+                while (!truncated && (size = direct ? hash_direct_read(file.fd.plain, fullpath, buf, read_size, &direct)
+                                                    : (off_t) TEMP_FAILURE_RETRY(hashsum_read(file,buf,read_size)))>0) {
+                    read_offset += size;
+                    if (file.compression == COMPRESSION_PLAIN) {
+                        /* the decompressor accounts the compressed reads */
+                        io_limit_read(new_fs.st_dev, size);
+                        if (!direct) {
+                            hash_drop_cache(file.fd.plain, fullpath, read_offset - size, size);
+                        }
+                        if ((size_t) size == read_size) {
+                            hash_readahead(file.fd.plain, fullpath, read_offset, read_size);
+                        }
+                    }
 
                     off_t update_md_size;
                     if (limit_size > 0 && r_size+size > limit_size) {
@@ -263,11 +849,10 @@ md_hashsums calc_hashsums(char* fullpath, DB_ATTR_TYPE attr, struct stat* old_fs
                         update_md_size = size;
                     }
 
-                    if (update_md(&mdc,buf,update_md_size)!=RETOK) {
+                    if (update_md(mdc,buf,update_md_size)!=RETOK) {
                         log_msg(LOG_LEVEL_WARNING, "hash calculation: update_md() failed for '%s' (hashsums could not be calculated)", fullpath);
-                        free(buf);
                         hashsum_close(file);
-                        close_md(&mdc, NULL, fullpath);
+                        hash_engine_close_md(engine, mdc, NULL, fullpath);
                         return md_hash;
                     }
                     r_size+=update_md_size;
@@ -279,40 +864,26 @@ md_hashsums calc_hashsums(char* fullpath, DB_ATTR_TYPE attr, struct stat* old_fs
                         break;
                     }
                 }
-                if (uncompress == false) {
-                    bool mismatch = false;
-                    bool lower = false;
-                    long long target_size = old_fs->st_size;
-                    if (limit_size > 0) {
-                        if (r_size < limit_size) {
-                            target_size = limit_size;
-                            lower = true;
-                            mismatch = true;
-                        }
-                    } else if (attr&ATTR(attr_growing)) {
-                        if (r_size < old_fs->st_size) {
-                            lower = true;
-                            mismatch = true;
-                        }
-                    } else {
-                        if (r_size != old_fs->st_size) {
-                            lower = r_size<old_fs->st_size;
-                            mismatch = true;
-                        }
-                    }
-                    if (mismatch) {
-                        log_msg(LOG_LEVEL_WARNING, "hash calculation: number of bytes read (%lld) mismatches %s size (%lld) for '%s'%s (hashsums could not be calculated)",
-                                (long long) r_size, limit_size > 0?"limited":"stat", target_size, fullpath,
-                                lower?", was file truncated while AIDE was running?":", was file growing while AIDE was running? (consider adding 'growing' attribute)"
-                               );
-                        free(buf);
-                        hashsum_close(file);
-                        close_md(&mdc, NULL, fullpath);
-                        return md_hash;
-                    }
+                if (size < 0 && file.compression == COMPRESSION_DECOMPRESSOR) {
+                    /* the error has been logged by the decompressor */
+                    hashsum_close(file);
+                    hash_engine_close_md(engine, mdc, NULL, fullpath);
+                    return md_hash;
+                }
+                if (!direct) {
+                    /* the last (partial) page of the file is not dropped with its window */
+                    hash_drop_cache(filedes, fullpath, 0, 0);
+                }
+                if (uncompress == false && hashsum_check_size(fullpath, attr, old_fs, limit_size, r_size) != RETOK) {
+                    hashsum_close(file);
+                    hash_engine_close_md(engine, mdc, NULL, fullpath);
+                    return md_hash;
+                }
+                hash_engine_close_md(engine, mdc, &md_hash, fullpath);
+                if (sampled_hash.attrs) {
+                    memcpy(md_hash.hashsums[hash_sampled], sampled_hash.hashsums[hash_sampled], hashsums[hash_sampled].length);
+                    md_hash.attrs |= sampled_hash.attrs;
                 }
-                free(buf);
-                close_md(&mdc, &md_hash, fullpath);
                 hashsum_close(file);
                 return md_hash;
             } else {
@@ -323,6 +894,92 @@ md_hashsums calc_hashsums(char* fullpath, DB_ATTR_TYPE attr, struct stat* old_fs
         }
 }
 
+/*
+ * read_small_file()
+ * reads the whole file (at most MULTI_HASH_MAX_SIZE+1 bytes, so a growing
+ * file is detected by hashsum_check_size), returns the number of bytes read
+ * or -1 on error
+ */
+static ssize_t read_small_file(int filedes, dev_t dev, char *buf) {
+    ssize_t r_size = 0;
+    ssize_t size = 0;
+    while (r_size <= MULTI_HASH_MAX_SIZE && (size = TEMP_FAILURE_RETRY(read(filedes, buf + r_size, MULTI_HASH_MAX_SIZE + 1 - r_size))) > 0) {
+        io_limit_read(dev, size);
+        r_size += size;
+    }
+    return size < 0 ? -1 : r_size;
+}
+
+/*
+ * the sha256 hashsums of all files are calculated at once in the SIMD lanes
+ * of the CPU (see hw_hash_sha256_multi()), the other hashsums per file
+ */
+void calc_hashsums_multi(multi_hash_file *files, int n) {
+    hash_engine *engine = get_hash_engine();
+    if (engine->multi_buf == NULL) {
+        engine->multi_buf = checked_malloc(HW_HASH_MAX_LANES * (MULTI_HASH_MAX_SIZE + 1)); /* freed in hash_engine_free */
+    }
+    const unsigned char *data[HW_HASH_MAX_LANES];
+    size_t len[HW_HASH_MAX_LANES];
+    int lane_file[HW_HASH_MAX_LANES];
+    unsigned char digest[HW_HASH_MAX_LANES][32];
+    int lanes = 0;
+
+    for (int i = 0 ; i < n ; ++i) {
+        multi_hash_file *file = &files[i];
+        file->md_hash.attrs = 0LLU;
+        file->filedes = open_file_at(file->dirfd, file->name, O_RDONLY|O_NOFOLLOW|O_NONBLOCK|O_NOCTTY|O_CLOEXEC);
+        if (file->filedes == -1) {
+            log_msg(LOG_LEVEL_WARNING, "hash calculation: open() failed for %s: %s (hashsums could not be calculated)", file->fullpath, strerror(errno));
+            continue;
+        }
+        struct stat new_fs;
+        if (fstat(file->filedes, &new_fs) != 0) {
+            log_msg(LOG_LEVEL_WARNING, "hash calculation: fstat() failed for '%s': %s (hashsums could not be calculated)", file->fullpath, strerror(errno));
+            continue;
+        }
+        if (hashsum_check_stat(file->fullpath, file->attr, &new_fs, file->old_fs) != RETOK) {
+            continue;
+        }
+        char *buf = engine->multi_buf + (size_t) i * (MULTI_HASH_MAX_SIZE + 1);
+        ssize_t r_size = read_small_file(file->filedes, new_fs.st_dev, buf);
+        hash_drop_cache(file->filedes, file->fullpath, 0, 0);
+        if (r_size < 0) {
+            log_msg(LOG_LEVEL_WARNING, "hash calculation: read() failed for '%s': %s (hashsums could not be calculated)", file->fullpath, strerror(errno));
+            continue;
+        }
+        if (hashsum_check_size(file->fullpath, file->attr, file->old_fs, -1, r_size) != RETOK) {
+            continue;
+        }
+        log_msg(LOG_LEVEL_DEBUG, "%s> calculate hashes for '%s' (multi-buffer)", file->fullpath, file->fullpath);
+        if (file->attr&get_hashes(true)&~ATTR(attr_sha256)) {
+            struct md_container *mdc = hash_engine_get_md(engine, file->attr&~ATTR(attr_sha256), file->fullpath);
+            if (mdc == NULL) {
+                log_msg(LOG_LEVEL_WARNING, "hash calculation: init_md() failed for '%s' (hashsums could not be calculated)", file->fullpath);
+                continue;
+            }
+            if (update_md(mdc, buf, r_size) != RETOK) {
+                log_msg(LOG_LEVEL_WARNING, "hash calculation: update_md() failed for '%s' (hashsums could not be calculated)", file->fullpath);
+                hash_engine_close_md(engine, mdc, NULL, file->fullpath);
+                continue;
+            }
+            hash_engine_close_md(engine, mdc, &file->md_hash, file->fullpath);
+        }
+        data[lanes] = (unsigned char *) buf;
+        len[lanes] = r_size;
+        lane_file[lanes++] = i;
+    }
+
+    if (lanes) {
+        hw_hash_sha256_multi(data, len, lanes, digest);
+    }
+    for (int lane = 0 ; lane < lanes ; ++lane) {
+        multi_hash_file *file = &files[lane_file[lane]];
+        memcpy(file->md_hash.hashsums[hash_sha256], digest[lane], hashsums[hash_sha256].length);
+        file->md_hash.attrs |= ATTR(attr_sha256);
+    }
+}
+
 void fs2db_line(struct stat* fs,db_line* line) {
   
   /* inode is always needed for ignoring changed filename */
@@ -385,7 +1042,7 @@ void fs2db_line(struct stat* fs,db_line* line) {
 }
 
 #ifdef WITH_ACL
-void acl2line(db_line* line) {
+void acl2line(db_line* line, int filedes) {
   acl_type *ret = NULL;
   
 #ifdef WITH_POSIX_ACL
@@ -394,7 +1051,11 @@ void acl2line(db_line* line) {
     acl_t acl_d = NULL;
     char *tmp = NULL;
 
-    acl_a = acl_get_file(line->fullpath, ACL_TYPE_ACCESS);
+    if (filedes >= 0) {
+        acl_a = acl_get_fd(filedes);
+    } else {
+        acl_a = acl_get_file(line->fullpath, ACL_TYPE_ACCESS);
+    }
     if (acl_a == NULL) {
         if (errno == ENOTSUP) {
             log_msg(LOG_LEVEL_TRACE, "failed to get acl of %s: file system does not support ACLs or ACLs are disabled", line->fullpath);
@@ -405,6 +1066,7 @@ void acl2line(db_line* line) {
         return;
     }
     if (S_ISDIR(line->perm)) {
+        /* there is no file descriptor based variant to get the default ACL */
         acl_d = acl_get_file(line->fullpath, ACL_TYPE_DEFAULT);
         if (acl_d == NULL) {
             log_msg(LOG_LEVEL_WARNING, "failed to get default ACL of %s: %s", line->fullpath, strerror(errno));
@@ -481,18 +1143,26 @@ static void xattr_add(xattrs_type *xattrs, const char *key, const char
     xattrs->num += 1;
 }
 
-void xattrs2line(db_line *line) {
+static ssize_t listxattr_fd_or_path(int filedes, const char *path, char *buf, size_t size) {
+    return filedes >= 0 ? flistxattr(filedes, buf, size) : llistxattr(path, buf, size);
+}
+
+static ssize_t getxattr_fd_or_path(int filedes, const char *path, const char *name, void *value, size_t size) {
+    return filedes >= 0 ? fgetxattr(filedes, name, value, size) : lgetxattr(path, name, value, size);
+}
+
+void xattrs2line(db_line *line, int filedes) {
     /* get all generic user xattrs. */
     xattrs_type *xattrs = NULL;
-    static ssize_t xsz = 1024;
-    static char *xatrs = NULL;
+    ssize_t xsz = 1024;
+    char *xatrs = NULL;
     ssize_t xret = -1;
 
     if ((ATTR(attr_xattrs)&line->attr)) {
 
-    if (!xatrs) xatrs = checked_malloc(xsz);
+    xatrs = checked_malloc(xsz); /* freed below */
 
-    while (((xret = llistxattr(line->fullpath, xatrs, xsz)) == -1) && (errno == ERANGE)) {
+    while (((xret = listxattr_fd_or_path(filedes, line->fullpath, xatrs, xsz)) == -1) && (errno == ERANGE)) {
         xsz <<= 1;
         xatrs = checked_realloc(xatrs, xsz);
     }
@@ -503,10 +1173,8 @@ void xattrs2line(db_line *line) {
         log_msg(LOG_LEVEL_WARNING, "listxattrs failed for %s:%s", line->fullpath, strerror(errno));
     } else if (xret) {
         const char *attr = xatrs;
-        static ssize_t asz = 1024;
-        static char *val = NULL;
-
-        if (!val) val = checked_malloc(asz);
+        ssize_t asz = 1024;
+        char *val = checked_malloc(asz); /* freed below */
 
         xattrs = xattr_new();
 
@@ -519,7 +1187,7 @@ void xattrs2line(db_line *line) {
                     strncmp(attr, "trusted.", strlen("trusted.")))
                 goto next_attr; /* only store normal xattrs, and SELinux */
 
-            while (((aret = lgetxattr(line->fullpath, attr, val, asz)) ==
+            while (((aret = getxattr_fd_or_path(filedes, line->fullpath, attr, val, asz)) ==
                         -1) && (errno == ERANGE)) {
                 asz <<= 1;
                 val = checked_realloc (val, asz);
@@ -534,7 +1202,9 @@ next_attr:
             attr += len + 1;
             xret -= len + 1;
         }
+        free(val);
     }
+    free(xatrs);
     }
 
     line->xattrs = xattrs;
@@ -542,12 +1212,12 @@ next_attr:
 #endif
 
 #ifdef WITH_SELINUX
-void selinux2line(db_line *line) {
+void selinux2line(db_line *line, int filedes) {
     char *cntx = NULL;
 
     if ((ATTR(attr_selinux)&line->attr)) {
 
-    if (lgetfilecon_raw(line->fullpath, &cntx) == -1) {
+    if ((filedes >= 0 ? fgetfilecon_raw(filedes, &cntx) : lgetfilecon_raw(line->fullpath, &cntx)) == -1) {
         line->attr&=(~ATTR(attr_selinux));
         if ((errno != ENOATTR) && (errno != EOPNOTSUPP))
             log_msg(LOG_LEVEL_WARNING, "lgetfilecon_raw failed for %s: %s", line->fullpath, strerror(errno));
@@ -565,10 +1235,10 @@ void selinux2line(db_line *line) {
 #endif
 
 #ifdef WITH_E2FSATTRS
-void e2fsattrs2line(db_line* line) {
+void e2fsattrs2line(db_line* line, int filedes) {
     unsigned long flags;
     if (ATTR(attr_e2fsattrs)&line->attr) {
-        if (fgetflags(line->fullpath, &flags) == 0) {
+        if ((filedes >= 0 ? getflags(filedes, &flags) : fgetflags(line->fullpath, &flags)) == 0) {
             line->e2fsattrs=flags;
         } else {
             line->attr&=(~ATTR(attr_e2fsattrs));
@@ -581,13 +1251,13 @@ void e2fsattrs2line(db_line* line) {
 #endif
 
 #ifdef WITH_CAPABILITIES
-void capabilities2line(db_line* line) {
+void capabilities2line(db_line* line, int filedes) {
     cap_t caps;
     char *txt_caps;
 
     if ((ATTR(attr_capabilities)&line->attr)) {
 
-    caps = cap_get_file(line->fullpath);
+    caps = filedes >= 0 ? cap_get_fd(filedes) : cap_get_file(line->fullpath);
 
     if (caps != NULL) {
         txt_caps = cap_to_text(caps, NULL);
@@ -18,8 +18,12 @@
  * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
  */
 
+#include "config.h"
 #include <e2p/e2p.h>
 #include <stdbool.h>
+#ifdef HAVE_STATX
+#include <sys/stat.h>
+#endif
 #include "e2fsattrs.h"
 #include "util.h"
 
@@ -99,3 +103,45 @@ char* get_e2fsattrs_string(unsigned long flags, bool flags_only, unsigned long i
     string[j] = '\0';
     return string;
 }
+
+#ifdef HAVE_STATX
+typedef struct {
+    unsigned long long stx;
+    unsigned long f;
+} e2fsattrs_statx_t;
+
+/* e2fs attributes also reported by statx(2) */
+static e2fsattrs_statx_t e2fsattrs_statx_flags[] = {
+    { STATX_ATTR_COMPRESSED, EXT2_COMPR_FL },
+    { STATX_ATTR_IMMUTABLE, EXT2_IMMUTABLE_FL },
+    { STATX_ATTR_APPEND, EXT2_APPEND_FL },
+    { STATX_ATTR_NODUMP, EXT2_NODUMP_FL },
+    { STATX_ATTR_ENCRYPTED, EXT4_ENCRYPT_FL },
+#if defined STATX_ATTR_VERITY && defined EXT4_VERITY_FL
+    { STATX_ATTR_VERITY, EXT4_VERITY_FL },
+#endif
+#if defined STATX_ATTR_DAX && defined FS_DAX_FL
+    { STATX_ATTR_DAX, FS_DAX_FL },
+#endif
+};
+
+bool get_e2fsattrs_from_statx(unsigned long long attributes_mask, unsigned long long attributes, unsigned long ignore_e2fsattrs, unsigned long *flags) {
+    unsigned long available = 0UL;
+    unsigned long result = 0UL;
+    for (unsigned long i = 0 ; i < sizeof(e2fsattrs_statx_flags)/sizeof(e2fsattrs_statx_t) ; ++i) {
+        if (e2fsattrs_statx_flags[i].stx & attributes_mask) {
+            available |= e2fsattrs_statx_flags[i].f;
+            if (e2fsattrs_statx_flags[i].stx & attributes) {
+                result |= e2fsattrs_statx_flags[i].f;
+            }
+        }
+    }
+    for (unsigned long i = 0 ; i < num_flags ; ++i) {
+        if (!(e2fsattrs_flags[i].f & (available|ignore_e2fsattrs))) {
+            return false;
+        }
+    }
+    *flags = result;
+    return true;
+}
+#endif
@@ -29,8 +29,10 @@
 #include <unistd.h>
 #include <limits.h>
 #include <sys/stat.h>
+#include <fcntl.h>
 #include <errno.h>
 #include <time.h>
+#include <pthread.h>
 #define PCRE2_CODE_UNIT_WIDTH 8
 #include <pcre2.h>
 
@@ -55,12 +57,15 @@
 #include "locale-aide.h"
 /*for locale support*/
 
-void hsymlnk(db_line* line);
+void hsymlnk(db_line* line, int dirfd, const char *name);
 void fs2db_line(struct stat* fs,db_line* line);
 void no_hash(db_line* line);
 
 LOG_LEVEL compare_log_level = LOG_LEVEL_COMPARE;
 
+static long num_reused_hashsums = 0;
+static pthread_mutex_t num_reused_hashsums_mutex = PTHREAD_MUTEX_INITIALIZER;
+
 static int bytecmp(byte *b1, byte *b2, size_t len) {
   return strncmp((char *)b1, (char *)b2, len);
 }
@@ -236,7 +241,7 @@ static DB_ATTR_TYPE get_changed_attributes(db_line* l1,db_line* l2, DB_ATTR_TYPE
                         if (l1->size) {
                             log_msg(compare_log_level, "┝ old:'%s' has growing attribute set, check for growing hashsums", l1->filename);
                             log_msg(compare_log_level, "│ compare hashsums of old:'%s' and new:'%s' (limited to old size %lld)", l1->filename, l2->filename, l1->size);
-                            md_hashsums hs = calc_hashsums(l2->fullpath, l2->attr, fs, l1->size, false);
+                            md_hashsums hs = calc_hashsums(-1, l2->fullpath, l2->attr, fs, l1->size, false);
 
                             byte* new_hashsums[num_hashes];
                             for (int i = 0 ; i < num_hashes ; ++i) {
@@ -374,6 +379,138 @@ void print_match(char* filename, rx_rule *rule, match_result match, RESTRICTION_
     }
 }
 
+/*
+ * Index of the hashsums of the old entries of a directory, used to find the
+ * original file of a compressed file (see 'compressed' attribute). The index
+ * maps each hashsum to the list of nodes with this old hashsum. It is built
+ * by populate_tree() after database_in has been read (only if a rule has the
+ * compressed attribute) and read without locks while the disk is scanned.
+ * The nodes are verified under their mutex as their old data may have been
+ * freed in the meantime.
+ */
+
+typedef struct old_hashsum {
+    HASHSUM hash;
+    byte *digest;
+    list *nodes;
+} old_hashsum;
+
+static int old_hashsum_cmp(const void *a, const void *b) {
+    const old_hashsum *h1 = a;
+    const old_hashsum *h2 = b;
+    if (h1->hash != h2->hash) {
+        return h1->hash < h2->hash ? -1 : 1;
+    }
+    return memcmp(h1->digest, h2->digest, hashsums[h1->hash].length);
+}
+
+static bool has_compressed_rule(seltree *node) {
+    for (list *r = node->sel_rx_lst ; r != NULL ; r = r->next) {
+        if (((rx_rule*) r->data)->attr&ATTR(attr_compressed)) {
+            return true;
+        }
+    }
+    for (list *r = node->equ_rx_lst ; r != NULL ; r = r->next) {
+        if (((rx_rule*) r->data)->attr&ATTR(attr_compressed)) {
+            return true;
+        }
+    }
+    for (tree_node *x = tree_walk_first(node->children) ; x != NULL ; x = tree_walk_next(x)) {
+        if (has_compressed_rule(tree_get_data(x))) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/* indexes the old entries of the children of dir and of all subdirectories */
+static long index_old_hashsums(seltree *dir) {
+    long num_indexed = 0;
+    for(tree_node *x = tree_walk_first(dir->children); x != NULL ; x = tree_walk_next(x)) {
+        seltree *child = tree_get_data(x);
+        if (child->old_data) {
+            for (int i = 0 ; i < num_hashes ; ++i) {
+                if ((child->old_data)->hashsums[i]) {
+                    old_hashsum key = { i, (child->old_data)->hashsums[i], NULL };
+                    old_hashsum *entry = tree_search(dir->old_hashsums, &key, old_hashsum_cmp);
+                    if (entry == NULL) {
+                        entry = checked_malloc(sizeof(old_hashsum)); /* freed in free_old_hashsums_index */
+                        entry->hash = i;
+                        entry->digest = checked_malloc(hashsums[i].length); /* freed in free_old_hashsums_index */
+                        memcpy(entry->digest, (child->old_data)->hashsums[i], hashsums[i].length);
+                        entry->nodes = NULL;
+                        dir->old_hashsums = tree_insert(dir->old_hashsums, entry, entry, old_hashsum_cmp);
+                    }
+                    entry->nodes = list_append(entry->nodes, child);
+                }
+            }
+            num_indexed++;
+        }
+        num_indexed += index_old_hashsums(child);
+    }
+    return num_indexed;
+}
+
+void free_old_hashsums_index(seltree *node) {
+    for (tree_node *x = tree_walk_first(node->old_hashsums) ; x != NULL ; x = tree_walk_next(x)) {
+        old_hashsum *entry = tree_get_data(x);
+        list *l = entry->nodes;
+        while (l != NULL) {
+            l = list_delete_item(l);
+        }
+        free(entry->digest);
+        free(entry);
+    }
+    tree_free(node->old_hashsums);
+    node->old_hashsums = NULL;
+    for (tree_node *x = tree_walk_first(node->children) ; x != NULL ; x = tree_walk_next(x)) {
+        free_old_hashsums_index(tree_get_data(x));
+    }
+}
+
+/*
+ * find_old_node_by_hashsums()
+ * returns the locked node (other than node) whose old entry has the same
+ * hashsums as new_hashsums or NULL if none is found
+ */
+static seltree *find_old_node_by_hashsums(seltree *node, db_line *new_file, byte **new_hashsums) {
+    seltree *dir = node->parent;
+    DB_ATTR_TYPE available_hashsums = get_hashes(false);
+
+    for (int i = 0 ; i < num_hashes ; ++i) {
+        if (new_hashsums[i] == NULL) {
+            continue;
+        }
+        old_hashsum key = { i, new_hashsums[i], NULL };
+        /* the index is not changed while the disk is scanned */
+        old_hashsum *entry = tree_search(dir->old_hashsums, &key, old_hashsum_cmp);
+        for (list *l = entry ? entry->nodes : NULL ; l != NULL ; l = l->next) {
+            seltree *moved_node = l->data;
+            if (moved_node != node) {
+                pthread_mutex_lock(&moved_node->mutex);
+                if (moved_node->old_data) {
+                    if ((new_file->attr&(moved_node->old_data)->attr)&available_hashsums) {
+                        log_msg(LOG_LEVEL_TRACE, "│ compare hashsums of old:'%s' with uncompressed hashsums of new:'%s'", (moved_node->old_data)->filename, new_file->filename);
+                        DB_ATTR_TYPE uncompressed_changed = get_changed_hashsums((moved_node->old_data)->hashsums, new_hashsums);
+                        if (uncompressed_changed) {
+                            char *str = diff_attributes(0,uncompressed_changed);
+                            log_msg(LOG_LEVEL_DEBUG, "│ hashsums of old:'%s' and uncompressed hashsums of new:'%s' have been CHANDED: %s)", (moved_node->old_data)->filename, new_file->filename, str);
+                            free(str);
+                        } else {
+                            log_msg(LOG_LEVEL_DEBUG, "│ hashsums of old:'%s' and uncompressed hashsums of new:'%s' have NOT been changed)", (moved_node->old_data)->filename, new_file->filename);
+                            return moved_node;
+                        }
+                    } else {
+                        log_msg(LOG_LEVEL_DEBUG, "│ skip old:'%s' (no common hashsums with new:'%s')", (moved_node->old_data)->filename, new_file->filename);
+                    }
+                }
+                pthread_mutex_unlock(&moved_node->mutex);
+            }
+        }
+    }
+    return NULL;
+}
+
 /*
  * add_file_to_tree
  */
@@ -468,7 +605,7 @@ void add_file_to_tree(seltree* tree,db_line* file,int db_flags, const database *
       log_msg(LOG_LEVEL_DEBUG, "│ '%s' is new (no old data exists)", node->path);
   }
 
-  DB_ATTR_TYPE move_ignored_attr = ATTR(attr_allownewfile)|ATTR(attr_allowrmfile)|ATTR(attr_checkinode)|ATTR(attr_compressed)|ATTR(attr_growing);
+  DB_ATTR_TYPE move_ignored_attr = ATTR(attr_allownewfile)|ATTR(attr_allowrmfile)|ATTR(attr_checkinode)|ATTR(attr_compressed)|ATTR(attr_growing)|ATTR(attr_reuse);
   if (db_flags&DB_NEW) {
       db_line *new_file = node->new_data;
       if (new_file->attr&ATTR(attr_compressed)) {
@@ -479,7 +616,7 @@ void add_file_to_tree(seltree* tree,db_line* file,int db_flags, const database *
 
                   seltree *moved_node = NULL;
 
-                  md_hashsums hs = calc_hashsums(new_file->fullpath, new_file->attr, fs, -1, true);
+                  md_hashsums hs = calc_hashsums(-1, new_file->fullpath, new_file->attr, fs, -1, true);
                   if (hs.attrs) {
                       byte* new_hashsums[num_hashes];
                       for (int i = 0 ; i < num_hashes ; ++i) {
@@ -493,30 +630,7 @@ void add_file_to_tree(seltree* tree,db_line* file,int db_flags, const database *
                       }
                       log_msg(compare_log_level, "│ search for original file with uncompressed hashsums of new:'%s'", new_file->filename);
 
-                      for(tree_node *x = tree_walk_first((node->parent)->children); x != NULL ; x = tree_walk_next(x)) {
-                          moved_node = tree_get_data(x);
-                          if (moved_node != node) {
-                              pthread_mutex_lock(&moved_node->mutex);
-                              if (moved_node->old_data) {
-                                  if ((new_file->attr&(moved_node->old_data)->attr)&available_hashsums) {
-                                      log_msg(LOG_LEVEL_TRACE, "│ compare hashsums of old:'%s' with uncompressed hashsums of new:'%s'", (moved_node->old_data)->filename, new_file->filename);
-                                      DB_ATTR_TYPE uncompressed_changed = get_changed_hashsums((moved_node->old_data)->hashsums, new_hashsums);
-                                      if (uncompressed_changed) {
-                                          char *str = diff_attributes(0,uncompressed_changed);
-                                          log_msg(LOG_LEVEL_DEBUG, "│ hashsums of old:'%s' and uncompressed hashsums of new:'%s' have been CHANDED: %s)", (moved_node->old_data)->filename, new_file->filename, str);
-                                          free(str);
-                                      } else {
-                                          log_msg(LOG_LEVEL_DEBUG, "│ hashsums of old:'%s' and uncompressed hashsums of new:'%s' have NOT been changed)", (moved_node->old_data)->filename, new_file->filename);
-                                          break;
-                                      }
-                                  } else {
-                                      log_msg(LOG_LEVEL_DEBUG, "│ skip old:'%s' (no common hashsums with new:'%s')", (moved_node->old_data)->filename, new_file->filename);
-                                  }
-                              }
-                              pthread_mutex_unlock(&moved_node->mutex);
-                          }
-                          moved_node = NULL;
-                      }
+                      moved_node = find_old_node_by_hashsums(node, new_file, new_hashsums);
 
                       for (int i = 0 ; i < num_hashes ; ++i) {
                           free(new_hashsums[i]);
@@ -625,9 +739,13 @@ void add_file_to_tree(seltree* tree,db_line* file,int db_flags, const database *
   pthread_mutex_unlock(&node->mutex);
 }
 
+static pthread_mutex_t limit_md_mutex = PTHREAD_MUTEX_INITIALIZER;
+
 match_result check_limit(char* filename) {
     if(conf->limit!=NULL) {
+        pthread_mutex_lock(&limit_md_mutex);
         int match=pcre2_match(conf->limit_crx, (PCRE2_SPTR) filename, PCRE2_ZERO_TERMINATED, 0, PCRE2_PARTIAL_SOFT, conf->limit_md, NULL);
+        pthread_mutex_unlock(&limit_md_mutex);
         if (match >= 0) {
             log_msg(LOG_LEVEL_TRACE, "'%s' does match limit '%s'", filename, conf->limit);
             return 0;
@@ -658,7 +776,126 @@ match_result check_rxtree(char* filename,seltree* tree, rx_rule* *rule, RESTRICT
   return check_seltree(tree, filename, file_type, rule);
 }
 
-db_line* get_file_attrs(char* filename,DB_ATTR_TYPE attr, struct stat *fs)
+/*
+ * get_old_hashsums()
+ * copies the hashsums of the database_in entry of line to old, returns false
+ * if there is no such entry or if its inode, size, mtime or ctime differ from
+ * fs (or have not been stored)
+ */
+static bool get_old_hashsums(db_line *line, struct stat *fs, md_hashsums *old) {
+    DB_ATTR_TYPE stat_attrs = ATTR(attr_inode)|ATTR(attr_size)|ATTR(attr_mtime)|ATTR(attr_ctime);
+    bool unchanged = false;
+    old->attrs = 0LLU;
+    seltree *node = get_seltree_node(conf->tree, line->filename);
+    if (node == NULL) {
+        return false;
+    }
+    pthread_mutex_lock(&node->mutex);
+    db_line *old_line = node->old_data;
+    if (old_line && S_ISREG(old_line->perm) && (old_line->attr&stat_attrs) == stat_attrs
+            && (ino_t) old_line->inode == fs->st_ino && old_line->size == fs->st_size
+            && old_line->mtime == fs->st_mtime && old_line->ctime == fs->st_ctime) {
+        for (int i = 0 ; i < num_hashes ; ++i) {
+            DB_ATTR_TYPE attr = ATTR(hashsums[i].attribute);
+            if (old_line->attr&attr && old_line->hashsums[i]) {
+                memcpy(old->hashsums[i], old_line->hashsums[i], hashsums[i].length);
+                old->attrs |= attr;
+            }
+        }
+        unchanged = true;
+    }
+    pthread_mutex_unlock(&node->mutex);
+    return unchanged;
+}
+
+static void merge_hashsums(md_hashsums *hs, md_hashsums *other, DB_ATTR_TYPE attrs) {
+    for (int i = 0 ; i < num_hashes ; ++i) {
+        DB_ATTR_TYPE attr = ATTR(hashsums[i].attribute);
+        if (attrs&other->attrs&attr) {
+            memcpy(hs->hashsums[i], other->hashsums[i], hashsums[i].length);
+            hs->attrs |= attr;
+        }
+    }
+}
+
+long get_num_reused_hashsums(void) {
+    pthread_mutex_lock(&num_reused_hashsums_mutex);
+    long n = num_reused_hashsums;
+    pthread_mutex_unlock(&num_reused_hashsums_mutex);
+    return n;
+}
+
+/*
+ * calc_file_hashsums()
+ * fd: file descriptor of the file or -1, it is closed by calc_file_hashsums
+ */
+static md_hashsums calc_file_hashsums(int fd, db_line *line, struct stat *fs) {
+    DB_ATTR_TYPE hashes = line->attr&get_hashes(true);
+    md_hashsums old;
+    if (line->attr&ATTR(attr_reuse) && conf->action&DO_COMPARE
+            && get_old_hashsums(line, fs, &old) && (old.attrs&hashes) == hashes) {
+        char *str;
+        log_msg(LOG_LEVEL_DEBUG, "%s> inode, size, mtime and ctime unchanged, reuse hashsums from database_in: %s", line->fullpath, str = diff_attributes(0, hashes));
+        free(str);
+        if (fd >= 0) {
+            close(fd);
+        }
+        md_hashsums hs = { .attrs = 0LLU };
+        merge_hashsums(&hs, &old, hashes);
+        pthread_mutex_lock(&num_reused_hashsums_mutex);
+        num_reused_hashsums++;
+        pthread_mutex_unlock(&num_reused_hashsums_mutex);
+        return hs;
+    }
+#ifdef WITH_XXHASH
+    DB_ATTR_TYPE other_hashes = hashes&~ATTR(attr_xxh128);
+    if (conf->xxh128_shortcut && conf->action&DO_COMPARE && hashes&ATTR(attr_xxh128) && other_hashes
+            && get_old_hashsums(line, fs, &old) && old.attrs&ATTR(attr_xxh128)) {
+        char *str;
+        /* calc_hashsums() closes fd, keep a duplicate for the second pass */
+        int second_fd = fd >= 0 ? dup(fd) : -1;
+        md_hashsums hs = calc_hashsums(fd, line->fullpath, line->attr&~other_hashes, fs, -1, false);
+        if (!(hs.attrs&ATTR(attr_xxh128))) {
+            if (second_fd >= 0) {
+                close(second_fd);
+            }
+            return hs;
+        }
+        if (bytecmp(hs.hashsums[hash_xxh128], old.hashsums[hash_xxh128], hashsums[hash_xxh128].length) == 0) {
+            merge_hashsums(&hs, &old, other_hashes);
+            log_msg(LOG_LEVEL_DEBUG, "%s> xxh128 hashsum and metadata unchanged, copy hashsums from database_in: %s", line->fullpath, str = diff_attributes(0, other_hashes&old.attrs));
+            free(str);
+            other_hashes &= ~old.attrs;
+        } else {
+            log_msg(LOG_LEVEL_DEBUG, "%s> xxh128 hashsum changed, calculate remaining hashsums", line->fullpath);
+        }
+        if (other_hashes) {
+            /* the duplicate shares the file offset, which is at the end of the file */
+            if (second_fd >= 0 && lseek(second_fd, 0, SEEK_SET) == -1) {
+                log_msg(LOG_LEVEL_DEBUG, "%s> lseek() failed for '%s': %s (open file again)", line->fullpath, line->fullpath, strerror(errno));
+                close(second_fd);
+                second_fd = -1;
+            }
+            md_hashsums remaining = calc_hashsums(second_fd, line->fullpath, (line->attr&~hashes)|other_hashes, fs, -1, false);
+            merge_hashsums(&hs, &remaining, other_hashes);
+        } else if (second_fd >= 0) {
+            close(second_fd);
+        }
+        return hs;
+    }
+#endif
+    return calc_hashsums(fd, line->fullpath, line->attr, fs, -1, false);
+}
+
+/*
+ * get_file_attrs()
+ * dirfd: file descriptor of the parent directory of filename or AT_FDCWD
+ * e2fsattrs: e2fs attributes if already known (e.g. from statx()) or -1
+ * filedes: file descriptor of filename if already opened or -1, it is closed
+ *          by get_file_attrs
+ * md_hash: hashsums if already calculated (e.g. by the io_uring engine) or NULL
+ */
+db_line* get_file_attrs(char* filename,DB_ATTR_TYPE attr, struct stat *fs, int dirfd, long e2fsattrs, int filedes, md_hashsums *md_hash)
 {
   log_msg(LOG_LEVEL_DEBUG, "get file attributes '%s' (fullpath: '%s')", &filename[conf->root_prefix_length], filename);
   db_line* line=NULL;
@@ -714,11 +951,14 @@ db_line* get_file_attrs(char* filename,DB_ATTR_TYPE attr, struct stat *fs)
   line->perm_o=fs->st_mode;
   line->linkname=NULL;
 
+  /* resolve the file relative to its parent directory (if available) */
+  const char *name = dirfd == AT_FDCWD ? filename : strrchr(filename, '/')+1;
+
   /*
     Handle symbolic link
   */
   
-  hsymlnk(line);
+  hsymlnk(line, dirfd, name);
   
   /*
     Set normal part
@@ -726,32 +966,59 @@ db_line* get_file_attrs(char* filename,DB_ATTR_TYPE attr, struct stat *fs)
   
   fs2db_line(fs,line);
   
+  /*
+    Open regular files and directories once for all remaining attributes,
+    the attribute functions fall back to the full path if this fails
+    (e.g. missing read permission)
+  */
+
+  int fd = filedes;
+  DB_ATTR_TYPE fd_attrs = (md_hash?0:get_hashes(true))|ATTR(attr_acl)|ATTR(attr_xattrs)|ATTR(attr_selinux)|ATTR(attr_capabilities)|(e2fsattrs < 0?ATTR(attr_e2fsattrs):0);
+  if (fd < 0 && line->attr&fd_attrs && (S_ISREG(fs->st_mode) || S_ISDIR(fs->st_mode))) {
+    fd = open_file_at(dirfd, name, O_RDONLY|O_NOFOLLOW|O_NONBLOCK|O_NOCTTY|O_CLOEXEC);
+    if (fd < 0) {
+      log_msg(LOG_LEVEL_DEBUG, "%s> open() failed: %s (fall back to path based access)", filename, strerror(errno));
+    }
+  }
+
   /*
     ACL stuff
   */
 
 #ifdef WITH_ACL
-  acl2line(line);
+  acl2line(line, fd);
 #endif
 
 #ifdef WITH_XATTR
-  xattrs2line(line);
+  xattrs2line(line, fd);
 #endif
 
 #ifdef WITH_SELINUX
-  selinux2line(line);
+  selinux2line(line, fd);
 #endif
 
 #ifdef WITH_E2FSATTRS
-    e2fsattrs2line(line);
+  if (e2fsattrs >= 0 && line->attr&ATTR(attr_e2fsattrs)) {
+    line->e2fsattrs=e2fsattrs;
+  } else {
+    e2fsattrs2line(line, fd);
+  }
 #endif
 
 #ifdef WITH_CAPABILITIES
-    capabilities2line(line);
+    capabilities2line(line, fd);
 #endif
 
-  if (line->attr&get_hashes(true) && S_ISREG(fs->st_mode)) {
-    md_hashsums hs = calc_hashsums(line->fullpath, line->attr, fs, -1, false);
+  if (md_hash && line->attr&get_hashes(true) && S_ISREG(fs->st_mode)) {
+    if (md_hash->attrs) {
+        hashsums2line(md_hash,line);
+    } else {
+        no_hash(line);
+    }
+  } else if (line->attr&get_hashes(true) && S_ISREG(fs->st_mode)) {
+    /* fd is closed by calc_file_hashsums */
+    md_hashsums hs = calc_file_hashsums(fd, line, fs);
+    fd = -1;
     if (hs.attrs) {
         hashsums2line(&hs,line);
     } else {
@@ -764,6 +1031,9 @@ db_line* get_file_attrs(char* filename,DB_ATTR_TYPE attr, struct stat *fs)
     */
     no_hash(line);
   }
+  if (fd >= 0) {
+    close(fd);
+  }
   /* attr_filename is always needed/returned but never requested */
   DB_ATTR_TYPE returned_attr = (~ATTR(attr_filename)&line->attr);
   log_msg(LOG_LEVEL_DEBUG, "%s> returned attributes: %llu (%s)", filename, returned_attr, str = diff_attributes(0, returned_attr));
@@ -825,6 +1095,11 @@ void populate_tree(seltree* tree)
                 }
             }
             db_lex_delete_buffer(&(conf->database_in));
+            if (conf->action&DO_COMPARE && has_compressed_rule(tree)) {
+                log_msg(LOG_LEVEL_INFO, "index hashsums of old entries (compressed attribute is used)");
+                long num_indexed = index_old_hashsums(tree);
+                log_msg(LOG_LEVEL_DEBUG, "indexed hashsums of %ld old entries", num_indexed);
+            }
     }
     if(conf->action&DO_DIFF){
         progress_status(PROGRESS_NEWDB, NULL);
@@ -853,7 +1128,7 @@ void populate_tree(seltree* tree)
     }
 }
 
-void hsymlnk(db_line* line) {
+void hsymlnk(db_line* line, int dirfd, const char *name) {
   
   line->linkname = NULL;
   if (line->attr&ATTR(attr_linkname)) {
@@ -868,7 +1143,7 @@ void hsymlnk(db_line* line) {
     if(conf->warn_dead_symlinks==1) {
       struct stat fs;
       int sres;
-      sres=stat(line->fullpath,&fs);
+      sres=fstatat(dirfd,name,&fs,0);
       if (sres!=0 && sres!=EACCES) {
 	log_msg(LOG_LEVEL_WARNING,"Dead symlink detected at %s",line->fullpath);
       }
@@ -894,7 +1169,7 @@ void hsymlnk(db_line* line) {
     */
     memset(line->linkname,0,_POSIX_PATH_MAX+1);
     
-    len=readlink(line->fullpath,line->linkname,_POSIX_PATH_MAX+1);
+    len=readlinkat(dirfd,name,line->linkname,_POSIX_PATH_MAX+1);
     if (len < 0) {
         log_msg(LOG_LEVEL_WARNING, "readlink() failed for '%s': %s", line->fullpath, strerror(errno));
         line->attr&=(~ATTR(attr_linkname));
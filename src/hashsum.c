@@ -44,6 +44,10 @@ hashsum_t hashsums[] = {
     { attr_gostr3411_94,    32 },
     { attr_stribog256,      32 },
     { attr_stribog512,      64 },
+    { attr_merkle,          32 },
+    { attr_blake3,          32 },
+    { attr_xxh128,          16 },
+    { attr_sampled,         32 },
 };
 
 #ifdef WITH_MHASH
@@ -65,6 +69,18 @@ int algorithms[] = { /* order must match hashsums array */
   MHASH_GOST,
   -1, /* stribog256 not available */
   -1, /* stribog512 not available */
+  MHASH_SHA256, /* merkle: tree of SHA-256 chunk hashes (see md.c) */
+#ifdef WITH_BLAKE3
+  ALGORITHM_OTHER, /* blake3: libblake3 */
+#else
+  -1, /* blake3 not available */
+#endif
+#ifdef WITH_XXHASH
+  ALGORITHM_OTHER, /* xxh128: libxxhash */
+#else
+  -1, /* xxh128 not available */
+#endif
+  MHASH_SHA256, /* sampled: SHA-256 of sampled windows (see do_md.c) */
 };
 #endif
 
@@ -83,6 +99,18 @@ int algorithms[] = { /* order must match hashsums array */
   GCRY_MD_GOSTR3411_94,
   GCRY_MD_STRIBOG256,
   GCRY_MD_STRIBOG512,
+  GCRY_MD_SHA256, /* merkle: tree of SHA-256 chunk hashes (see md.c) */
+#ifdef WITH_BLAKE3
+  ALGORITHM_OTHER, /* blake3: libblake3 */
+#else
+  -1, /* blake3 not available */
+#endif
+#ifdef WITH_XXHASH
+  ALGORITHM_OTHER, /* xxh128: libxxhash */
+#else
+  -1, /* xxh128 not available */
+#endif
+  GCRY_MD_SHA256, /* sampled: SHA-256 of sampled windows (see do_md.c) */
 };
 #endif
 
@@ -0,0 +1,514 @@
+/*
+ * AIDE (Advanced Intrusion Detection Environment)
+ *
+ * Copyright (C) 2026 Hannes von Haugwitz
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HW_HASH_X86
+#include <cpuid.h>
+#include <immintrin.h>
+#elif defined(__GNUC__) && defined(__aarch64__) && defined(__linux__)
+#define HW_HASH_ARM
+#include <arm_neon.h>
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+
+#ifdef WITH_GCRYPT
+#include <gcrypt.h>
+#endif
+
+#include "attributes.h"
+#include "hashsum.h"
+#include "hw_hash.h"
+
+#define HW_HASH_BLOCK_SIZE 64
+
+static const uint32_t sha1_init[5] = {
+    0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0,
+};
+
+static const uint32_t sha256_init[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+    0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+};
+
+#if defined(HW_HASH_X86) || defined(HW_HASH_ARM)
+static const uint32_t sha256_k[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+#endif
+
+typedef void (*compress_func)(uint32_t *, const unsigned char *, size_t);
+typedef void (*multi_compress_func)(uint32_t (*)[HW_HASH_MAX_LANES], const unsigned char **);
+
+static pthread_once_t hw_hash_once = PTHREAD_ONCE_INIT;
+static DB_ATTR_TYPE hw_attrs = 0LLU;
+static const char *hw_implementation = NULL;
+static compress_func sha1_compress = NULL;
+static compress_func sha256_compress = NULL;
+static multi_compress_func sha256_multi_compress = NULL;
+static int multi_lanes = 0;
+
+#ifdef HW_HASH_X86
+
+/*
+ * the message schedule is kept in w[], w[g%4] holds the 4 words used by
+ * the rounds 4*g to 4*g+3
+ */
+
+__attribute__((target("sha,sse4.1")))
+static void sha1_compress_shani(uint32_t *state, const unsigned char *data, size_t blocks) {
+    const __m128i mask = _mm_set_epi64x(0x0001020304050607ULL, 0x08090a0b0c0d0e0fULL);
+    __m128i abcd = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *) state), 0x1b);
+    __m128i e0 = _mm_set_epi32(state[4], 0, 0, 0);
+    __m128i w[4];
+
+    while (blocks--) {
+        __m128i abcd_save = abcd;
+        __m128i e_save = e0;
+        __m128i e = e0;
+#pragma GCC unroll 20
+        for (int g = 0 ; g < 20 ; ++g) {
+            if (g < 4) {
+                w[g] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) (data + 16*g)), mask);
+            } else {
+                w[g&3] = _mm_sha1msg2_epu32(_mm_xor_si128(_mm_sha1msg1_epu32(w[g&3], w[(g+1)&3]), w[(g+2)&3]), w[(g+3)&3]);
+            }
+            e = g ? _mm_sha1nexte_epu32(e, w[g&3]) : _mm_add_epi32(e, w[0]);
+            __m128i abcd_prev = abcd;
+            switch (g/5) {
+                case 0: abcd = _mm_sha1rnds4_epu32(abcd, e, 0); break;
+                case 1: abcd = _mm_sha1rnds4_epu32(abcd, e, 1); break;
+                case 2: abcd = _mm_sha1rnds4_epu32(abcd, e, 2); break;
+                default: abcd = _mm_sha1rnds4_epu32(abcd, e, 3); break;
+            }
+            e = abcd_prev;
+        }
+        e0 = _mm_sha1nexte_epu32(e, e_save);
+        abcd = _mm_add_epi32(abcd, abcd_save);
+        data += HW_HASH_BLOCK_SIZE;
+    }
+
+    _mm_storeu_si128((__m128i *) state, _mm_shuffle_epi32(abcd, 0x1b));
+    state[4] = _mm_extract_epi32(e0, 3);
+}
+
+__attribute__((target("sha,sse4.1")))
+static void sha256_compress_shani(uint32_t *state, const unsigned char *data, size_t blocks) {
+    const __m128i mask = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+    __m128i tmp = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *) &state[0]), 0xb1); /* CDAB */
+    __m128i state1 = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *) &state[4]), 0x1b); /* EFGH */
+    __m128i state0 = _mm_alignr_epi8(tmp, state1, 8); /* ABEF */
+    state1 = _mm_blend_epi16(state1, tmp, 0xf0); /* CDGH */
+    __m128i w[4];
+
+    while (blocks--) {
+        __m128i abef_save = state0;
+        __m128i cdgh_save = state1;
+#pragma GCC unroll 16
+        for (int g = 0 ; g < 16 ; ++g) {
+            if (g < 4) {
+                w[g] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) (data + 16*g)), mask);
+            } else {
+                __m128i x = _mm_add_epi32(_mm_sha256msg1_epu32(w[g&3], w[(g+1)&3]), _mm_alignr_epi8(w[(g+3)&3], w[(g+2)&3], 4));
+                w[g&3] = _mm_sha256msg2_epu32(x, w[(g+3)&3]);
+            }
+            __m128i msg = _mm_add_epi32(w[g&3], _mm_loadu_si128((const __m128i *) &sha256_k[4*g]));
+            state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+            state0 = _mm_sha256rnds2_epu32(state0, state1, _mm_shuffle_epi32(msg, 0x0e));
+        }
+        state0 = _mm_add_epi32(state0, abef_save);
+        state1 = _mm_add_epi32(state1, cdgh_save);
+        data += HW_HASH_BLOCK_SIZE;
+    }
+
+    tmp = _mm_shuffle_epi32(state0, 0x1b); /* FEBA */
+    state1 = _mm_shuffle_epi32(state1, 0xb1); /* DCHG */
+    _mm_storeu_si128((__m128i *) &state[0], _mm_blend_epi16(tmp, state1, 0xf0)); /* DCBA */
+    _mm_storeu_si128((__m128i *) &state[4], _mm_alignr_epi8(state1, tmp, 8)); /* HGFE */
+}
+
+/*
+ * multi-buffer SHA-256: lane i of the vectors holds the state (or message
+ * word) of the message i, so all messages run through the rounds at once
+ */
+
+static inline uint32_t load_be32(const unsigned char *p) {
+    return (uint32_t) p[0]<<24 | (uint32_t) p[1]<<16 | (uint32_t) p[2]<<8 | (uint32_t) p[3];
+}
+
+#define AVX2_ROR(x, n) _mm256_or_si256(_mm256_srli_epi32(x, n), _mm256_slli_epi32(x, 32-(n)))
+#define AVX2_XOR3(x, y, z) _mm256_xor_si256(_mm256_xor_si256(x, y), z)
+
+__attribute__((target("avx2")))
+static void sha256_multi_compress_avx2(uint32_t (*state)[HW_HASH_MAX_LANES], const unsigned char **blocks) {
+    __m256i s[8], w[16];
+    for (int i = 0 ; i < 8 ; ++i) {
+        s[i] = _mm256_loadu_si256((const __m256i *) state[i]);
+    }
+    __m256i a = s[0], b = s[1], c = s[2], d = s[3], e = s[4], f = s[5], g = s[6], h = s[7];
+
+#pragma GCC unroll 16
+    for (int t = 0 ; t < 64 ; ++t) {
+        if (t < 16) {
+            w[t] = _mm256_setr_epi32(
+                    load_be32(blocks[0]+4*t), load_be32(blocks[1]+4*t), load_be32(blocks[2]+4*t), load_be32(blocks[3]+4*t),
+                    load_be32(blocks[4]+4*t), load_be32(blocks[5]+4*t), load_be32(blocks[6]+4*t), load_be32(blocks[7]+4*t));
+        } else {
+            __m256i w15 = w[(t-15)&15], w2 = w[(t-2)&15];
+            __m256i s0 = AVX2_XOR3(AVX2_ROR(w15, 7), AVX2_ROR(w15, 18), _mm256_srli_epi32(w15, 3));
+            __m256i s1 = AVX2_XOR3(AVX2_ROR(w2, 17), AVX2_ROR(w2, 19), _mm256_srli_epi32(w2, 10));
+            w[t&15] = _mm256_add_epi32(_mm256_add_epi32(w[t&15], s0), _mm256_add_epi32(w[(t-7)&15], s1));
+        }
+        __m256i ch = _mm256_xor_si256(_mm256_and_si256(e, f), _mm256_andnot_si256(e, g));
+        __m256i t1 = _mm256_add_epi32(_mm256_add_epi32(h, AVX2_XOR3(AVX2_ROR(e, 6), AVX2_ROR(e, 11), AVX2_ROR(e, 25))),
+                _mm256_add_epi32(_mm256_add_epi32(ch, _mm256_set1_epi32(sha256_k[t])), w[t&15]));
+        __m256i maj = _mm256_or_si256(_mm256_and_si256(a, b), _mm256_and_si256(c, _mm256_or_si256(a, b)));
+        __m256i t2 = _mm256_add_epi32(AVX2_XOR3(AVX2_ROR(a, 2), AVX2_ROR(a, 13), AVX2_ROR(a, 22)), maj);
+        h = g; g = f; f = e; e = _mm256_add_epi32(d, t1);
+        d = c; c = b; b = a; a = _mm256_add_epi32(t1, t2);
+    }
+
+    __m256i v[8] = { a, b, c, d, e, f, g, h };
+    for (int i = 0 ; i < 8 ; ++i) {
+        _mm256_storeu_si256((__m256i *) state[i], _mm256_add_epi32(s[i], v[i]));
+    }
+}
+
+#define AVX512_XOR3(x, y, z) _mm512_ternarylogic_epi32(x, y, z, 0x96)
+
+__attribute__((target("avx512f")))
+static void sha256_multi_compress_avx512(uint32_t (*state)[HW_HASH_MAX_LANES], const unsigned char **blocks) {
+    __m512i s[8], w[16];
+    for (int i = 0 ; i < 8 ; ++i) {
+        s[i] = _mm512_loadu_si512(state[i]);
+    }
+    __m512i a = s[0], b = s[1], c = s[2], d = s[3], e = s[4], f = s[5], g = s[6], h = s[7];
+
+#pragma GCC unroll 16
+    for (int t = 0 ; t < 64 ; ++t) {
+        if (t < 16) {
+            w[t] = _mm512_setr_epi32(
+                    load_be32(blocks[0]+4*t), load_be32(blocks[1]+4*t), load_be32(blocks[2]+4*t), load_be32(blocks[3]+4*t),
+                    load_be32(blocks[4]+4*t), load_be32(blocks[5]+4*t), load_be32(blocks[6]+4*t), load_be32(blocks[7]+4*t),
+                    load_be32(blocks[8]+4*t), load_be32(blocks[9]+4*t), load_be32(blocks[10]+4*t), load_be32(blocks[11]+4*t),
+                    load_be32(blocks[12]+4*t), load_be32(blocks[13]+4*t), load_be32(blocks[14]+4*t), load_be32(blocks[15]+4*t));
+        } else {
+            __m512i w15 = w[(t-15)&15], w2 = w[(t-2)&15];
+            __m512i s0 = AVX512_XOR3(_mm512_ror_epi32(w15, 7), _mm512_ror_epi32(w15, 18), _mm512_srli_epi32(w15, 3));
+            __m512i s1 = AVX512_XOR3(_mm512_ror_epi32(w2, 17), _mm512_ror_epi32(w2, 19), _mm512_srli_epi32(w2, 10));
+            w[t&15] = _mm512_add_epi32(_mm512_add_epi32(w[t&15], s0), _mm512_add_epi32(w[(t-7)&15], s1));
+        }
+        __m512i ch = _mm512_ternarylogic_epi32(e, f, g, 0xca);
+        __m512i t1 = _mm512_add_epi32(_mm512_add_epi32(h, AVX512_XOR3(_mm512_ror_epi32(e, 6), _mm512_ror_epi32(e, 11), _mm512_ror_epi32(e, 25))),
+                _mm512_add_epi32(_mm512_add_epi32(ch, _mm512_set1_epi32(sha256_k[t])), w[t&15]));
+        __m512i maj = _mm512_ternarylogic_epi32(a, b, c, 0xe8);
+        __m512i t2 = _mm512_add_epi32(AVX512_XOR3(_mm512_ror_epi32(a, 2), _mm512_ror_epi32(a, 13), _mm512_ror_epi32(a, 22)), maj);
+        h = g; g = f; f = e; e = _mm512_add_epi32(d, t1);
+        d = c; c = b; b = a; a = _mm512_add_epi32(t1, t2);
+    }
+
+    __m512i v[8] = { a, b, c, d, e, f, g, h };
+    for (int i = 0 ; i < 8 ; ++i) {
+        _mm512_storeu_si512(state[i], _mm512_add_epi32(s[i], v[i]));
+    }
+}
+
+static void hw_hash_detect(void) {
+    unsigned int eax, ebx, ecx, edx;
+    if (__get_cpuid(1, &eax, &ebx, &ecx, &edx) && ecx&bit_SSSE3 && ecx&bit_SSE4_1
+            && __get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx) && ebx&bit_SHA) {
+        sha1_compress = sha1_compress_shani;
+        sha256_compress = sha256_compress_shani;
+        hw_implementation = "x86 SHA extensions";
+    }
+    /*
+     * __builtin_cpu_supports() also checks that the OS saves the registers,
+     * 8 AVX2 lanes are slower than the SHA extensions
+     */
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) {
+        sha256_multi_compress = sha256_multi_compress_avx512;
+        multi_lanes = 16;
+    } else if (__builtin_cpu_supports("avx2") && sha256_compress == NULL) {
+        sha256_multi_compress = sha256_multi_compress_avx2;
+        multi_lanes = 8;
+    }
+}
+
+#elif defined(HW_HASH_ARM)
+
+#ifdef __clang__
+#define HW_HASH_ARM_TARGET __attribute__((target("crypto")))
+#else
+#define HW_HASH_ARM_TARGET __attribute__((target("+crypto")))
+#endif
+
+HW_HASH_ARM_TARGET
+static void sha1_compress_armv8(uint32_t *state, const unsigned char *data, size_t blocks) {
+    static const uint32_t k[4] = { 0x5a827999, 0x6ed9eba1, 0x8f1bbcdc, 0xca62c1d6 };
+    uint32x4_t abcd = vld1q_u32(state);
+    uint32_t e0 = state[4];
+    uint32x4_t w[4];
+
+    while (blocks--) {
+        uint32x4_t abcd_save = abcd;
+        uint32_t e_save = e0;
+#pragma GCC unroll 20
+        for (int g = 0 ; g < 20 ; ++g) {
+            if (g < 4) {
+                w[g] = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(data + 16*g)));
+            } else {
+                w[g&3] = vsha1su1q_u32(vsha1su0q_u32(w[g&3], w[(g+1)&3], w[(g+2)&3]), w[(g+3)&3]);
+            }
+            uint32x4_t msg = vaddq_u32(w[g&3], vdupq_n_u32(k[g/5]));
+            uint32_t e1 = vsha1h_u32(vgetq_lane_u32(abcd, 0));
+            if (g < 5) {
+                abcd = vsha1cq_u32(abcd, e0, msg);
+            } else if (g < 10 || g >= 15) {
+                abcd = vsha1pq_u32(abcd, e0, msg);
+            } else {
+                abcd = vsha1mq_u32(abcd, e0, msg);
+            }
+            e0 = e1;
+        }
+        abcd = vaddq_u32(abcd, abcd_save);
+        e0 += e_save;
+        data += HW_HASH_BLOCK_SIZE;
+    }
+
+    vst1q_u32(state, abcd);
+    state[4] = e0;
+}
+
+HW_HASH_ARM_TARGET
+static void sha256_compress_armv8(uint32_t *state, const unsigned char *data, size_t blocks) {
+    uint32x4_t state0 = vld1q_u32(&state[0]);
+    uint32x4_t state1 = vld1q_u32(&state[4]);
+    uint32x4_t w[4];
+
+    while (blocks--) {
+        uint32x4_t abcd_save = state0;
+        uint32x4_t efgh_save = state1;
+#pragma GCC unroll 16
+        for (int g = 0 ; g < 16 ; ++g) {
+            if (g < 4) {
+                w[g] = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(data + 16*g)));
+            } else {
+                w[g&3] = vsha256su1q_u32(vsha256su0q_u32(w[g&3], w[(g+1)&3]), w[(g+2)&3], w[(g+3)&3]);
+            }
+            uint32x4_t msg = vaddq_u32(w[g&3], vld1q_u32(&sha256_k[4*g]));
+            uint32x4_t abcd = state0;
+            state0 = vsha256hq_u32(state0, state1, msg);
+            state1 = vsha256h2q_u32(state1, abcd, msg);
+        }
+        state0 = vaddq_u32(state0, abcd_save);
+        state1 = vaddq_u32(state1, efgh_save);
+        data += HW_HASH_BLOCK_SIZE;
+    }
+
+    vst1q_u32(&state[0], state0);
+    vst1q_u32(&state[4], state1);
+}
+
+static void hw_hash_detect(void) {
+    unsigned long hwcap = getauxval(AT_HWCAP);
+    if (hwcap&HWCAP_SHA1 && hwcap&HWCAP_SHA2) {
+        sha1_compress = sha1_compress_armv8;
+        sha256_compress = sha256_compress_armv8;
+        hw_implementation = "ARMv8 cryptography extensions";
+    }
+}
+
+#else
+
+static void hw_hash_detect(void) {
+}
+
+#endif
+
+static void hw_hash_once_init(void) {
+#ifdef WITH_GCRYPT
+    /*
+     * in FIPS mode only the (validated) libgcrypt implementations are used,
+     * the mode is only known after libgcrypt is initialized (the calls of
+     * 'aide --version' and of the tests may come first)
+     */
+    gcry_check_version(NULL);
+    if (gcry_fips_mode_active()) {
+        return;
+    }
+#endif
+    hw_hash_detect();
+    if (sha1_compress) {
+        hw_attrs |= ATTR(attr_sha1);
+    }
+    if (sha256_compress) {
+        hw_attrs |= ATTR(attr_sha256);
+    }
+}
+
+DB_ATTR_TYPE hw_hash_attrs(void) {
+    pthread_once(&hw_hash_once, hw_hash_once_init);
+    return hw_attrs;
+}
+
+const char *hw_hash_implementation(void) {
+    pthread_once(&hw_hash_once, hw_hash_once_init);
+    return hw_implementation;
+}
+
+int hw_hash_multi_lanes(void) {
+    pthread_once(&hw_hash_once, hw_hash_once_init);
+    return multi_lanes;
+}
+
+void hw_hash_sha256_multi(const unsigned char **data, const size_t *len, int n, unsigned char (*digest)[32]) {
+    static const unsigned char zero_block[HW_HASH_BLOCK_SIZE];
+    uint32_t state[8][HW_HASH_MAX_LANES];
+    unsigned char pad[HW_HASH_MAX_LANES][2*HW_HASH_BLOCK_SIZE];
+    size_t full_blocks[HW_HASH_MAX_LANES];
+    size_t num_blocks[HW_HASH_MAX_LANES];
+    size_t max_blocks = 0;
+    const unsigned char *blocks[HW_HASH_MAX_LANES];
+
+    for (int i = 0 ; i < 8 ; ++i) {
+        for (int lane = 0 ; lane < HW_HASH_MAX_LANES ; ++lane) {
+            state[i][lane] = sha256_init[i];
+        }
+    }
+    /* the last (partial) block and the padding of each message are copied to pad[] */
+    for (int lane = 0 ; lane < n ; ++lane) {
+        full_blocks[lane] = len[lane] / HW_HASH_BLOCK_SIZE;
+        size_t rest = len[lane] % HW_HASH_BLOCK_SIZE;
+        size_t pad_blocks = rest + 9 > HW_HASH_BLOCK_SIZE ? 2 : 1;
+        memset(pad[lane], 0, sizeof(pad[lane]));
+        if (rest) {
+            memcpy(pad[lane], data[lane] + full_blocks[lane] * HW_HASH_BLOCK_SIZE, rest);
+        }
+        pad[lane][rest] = 0x80;
+        uint64_t bits = (uint64_t) len[lane] * 8;
+        for (int i = 0 ; i < 8 ; ++i) {
+            pad[lane][pad_blocks * HW_HASH_BLOCK_SIZE - 1 - i] = bits >> (8*i);
+        }
+        num_blocks[lane] = full_blocks[lane] + pad_blocks;
+        if (num_blocks[lane] > max_blocks) {
+            max_blocks = num_blocks[lane];
+        }
+    }
+
+    for (size_t blk = 0 ; blk < max_blocks ; ++blk) {
+        for (int lane = 0 ; lane < HW_HASH_MAX_LANES ; ++lane) {
+            if (lane >= n || blk >= num_blocks[lane]) {
+                blocks[lane] = zero_block;
+            } else if (blk < full_blocks[lane]) {
+                blocks[lane] = data[lane] + blk * HW_HASH_BLOCK_SIZE;
+            } else {
+                blocks[lane] = pad[lane] + (blk - full_blocks[lane]) * HW_HASH_BLOCK_SIZE;
+            }
+        }
+        sha256_multi_compress(state, blocks);
+        for (int lane = 0 ; lane < n ; ++lane) {
+            if (blk + 1 == num_blocks[lane]) {
+                for (int i = 0 ; i < 8 ; ++i) {
+                    digest[lane][4*i] = state[i][lane] >> 24;
+                    digest[lane][4*i+1] = state[i][lane] >> 16;
+                    digest[lane][4*i+2] = state[i][lane] >> 8;
+                    digest[lane][4*i+3] = state[i][lane];
+                }
+            }
+        }
+    }
+}
+
+void hw_hash_init(hw_hash_ctx *ctx, HASHSUM hash) {
+    if (hash == hash_sha1) {
+        memcpy(ctx->state, sha1_init, sizeof(sha1_init));
+        ctx->compress = sha1_compress;
+    } else {
+        memcpy(ctx->state, sha256_init, sizeof(sha256_init));
+        ctx->compress = sha256_compress;
+    }
+    ctx->buf_len = 0;
+    ctx->length = 0;
+}
+
+void hw_hash_update(hw_hash_ctx *ctx, const void *data, size_t size) {
+    const unsigned char *p = data;
+    ctx->length += size;
+    if (ctx->buf_len) {
+        size_t n = HW_HASH_BLOCK_SIZE - ctx->buf_len;
+        if (n > size) {
+            n = size;
+        }
+        memcpy(ctx->buf + ctx->buf_len, p, n);
+        ctx->buf_len += n;
+        p += n;
+        size -= n;
+        if (ctx->buf_len < HW_HASH_BLOCK_SIZE) {
+            return;
+        }
+        ctx->compress(ctx->state, ctx->buf, 1);
+        ctx->buf_len = 0;
+    }
+    if (size >= HW_HASH_BLOCK_SIZE) {
+        size_t blocks = size / HW_HASH_BLOCK_SIZE;
+        ctx->compress(ctx->state, p, blocks);
+        p += blocks * HW_HASH_BLOCK_SIZE;
+        size -= blocks * HW_HASH_BLOCK_SIZE;
+    }
+    memcpy(ctx->buf, p, size);
+    ctx->buf_len = size;
+}
+
+void hw_hash_final(hw_hash_ctx *ctx, HASHSUM hash, unsigned char *digest) {
+    uint64_t bits = ctx->length * 8;
+    ctx->buf[ctx->buf_len++] = 0x80;
+    if (ctx->buf_len > HW_HASH_BLOCK_SIZE - 8) {
+        memset(ctx->buf + ctx->buf_len, 0, HW_HASH_BLOCK_SIZE - ctx->buf_len);
+        ctx->compress(ctx->state, ctx->buf, 1);
+        ctx->buf_len = 0;
+    }
+    memset(ctx->buf + ctx->buf_len, 0, HW_HASH_BLOCK_SIZE - 8 - ctx->buf_len);
+    for (int i = 0 ; i < 8 ; ++i) {
+        ctx->buf[HW_HASH_BLOCK_SIZE - 1 - i] = bits >> (8*i);
+    }
+    ctx->compress(ctx->state, ctx->buf, 1);
+
+    int words = hash == hash_sha1 ? 5 : 8;
+    for (int i = 0 ; i < words ; ++i) {
+        digest[4*i] = ctx->state[i] >> 24;
+        digest[4*i+1] = ctx->state[i] >> 16;
+        digest[4*i+2] = ctx->state[i] >> 8;
+        digest[4*i+3] = ctx->state[i];
+    }
+}
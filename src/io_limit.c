@@ -0,0 +1,162 @@
+/*
+ * AIDE (Advanced Intrusion Detection Environment)
+ *
+ * Copyright (C) 2026 Hannes von Haugwitz
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "aide.h"
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <sys/types.h>
+
+#include "db_config.h"
+#include "io_limit.h"
+#include "log.h"
+#include "util.h"
+
+/*
+ * Token buckets: each bucket holds the time (in nanoseconds) up to which the
+ * reads accounted so far are allowed. A read of n units (bytes or requests)
+ * moves it by n/rate and the caller sleeps until the start of its slot. The
+ * bucket may lag behind the current time by IO_LIMIT_BURST, so short bursts
+ * are allowed after an idle period (e.g. while the workers process small
+ * files without reading).
+ */
+
+#define IO_LIMIT_BURST 100000000LL /* 100 ms */
+#define NSEC_PER_SEC 1000000000LL
+
+typedef struct io_bucket {
+    long long rate;
+    long long next;
+} io_bucket;
+
+#define IO_DEVICES_HASH_SIZE 256
+
+typedef struct io_device {
+    dev_t dev;
+    io_bucket bytes;
+    io_bucket requests;
+    struct io_device *hash_next;
+} io_device;
+
+static io_bucket global_bytes = { 0, 0 };
+static io_bucket global_requests = { 0, 0 };
+static io_device *io_devices_hash[IO_DEVICES_HASH_SIZE];
+static pthread_mutex_t io_limit_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static long long io_limit_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+/* returns the start of the slot of n units */
+static long long io_bucket_take(io_bucket *bucket, long long now, long long n) {
+    if (bucket->rate <= 0) {
+        return now;
+    }
+    if (bucket->next < now - IO_LIMIT_BURST) {
+        bucket->next = now - IO_LIMIT_BURST;
+    }
+    long long start = bucket->next;
+    bucket->next += n * NSEC_PER_SEC / bucket->rate;
+    return start;
+}
+
+static io_device *get_io_device(dev_t dev) {
+    io_device **bucket = &io_devices_hash[(unsigned long long) dev % IO_DEVICES_HASH_SIZE];
+    for (io_device *device = *bucket ; device != NULL ; device = device->hash_next) {
+        if (device->dev == dev) {
+            return device;
+        }
+    }
+    io_device *device = checked_malloc(sizeof(io_device)); /* freed on exit */
+    device->dev = dev;
+    device->bytes = (io_bucket) { conf->max_device_read_rate, 0 };
+    device->requests = (io_bucket) { conf->max_device_read_iops, 0 };
+    device->hash_next = *bucket;
+    *bucket = device;
+    return device;
+}
+
+bool io_limit_enabled(void) {
+    return conf->max_read_rate > 0 || conf->max_read_iops > 0
+        || conf->max_device_read_rate > 0 || conf->max_device_read_iops > 0;
+}
+
+void io_limit_read(dev_t dev, size_t size) {
+    if (!io_limit_enabled()) {
+        return;
+    }
+    pthread_mutex_lock(&io_limit_mutex);
+    global_bytes.rate = conf->max_read_rate;
+    global_requests.rate = conf->max_read_iops;
+    long long now = io_limit_now();
+    long long start = io_bucket_take(&global_bytes, now, size);
+    long long t = io_bucket_take(&global_requests, now, 1);
+    if (t > start) { start = t; }
+    if (conf->max_device_read_rate > 0 || conf->max_device_read_iops > 0) {
+        io_device *device = get_io_device(dev);
+        t = io_bucket_take(&device->bytes, now, size);
+        if (t > start) { start = t; }
+        t = io_bucket_take(&device->requests, now, 1);
+        if (t > start) { start = t; }
+    }
+    pthread_mutex_unlock(&io_limit_mutex);
+
+    long long delay = start - now;
+    if (delay > 0) {
+        struct timespec ts = { delay / NSEC_PER_SEC, delay % NSEC_PER_SEC };
+        while (nanosleep(&ts, &ts) == -1 && errno == EINTR);
+    }
+}
+
+void io_limit_set_worker_priority(const char *whoami) {
+    if (conf->worker_ioprio >= 0) {
+#ifdef SYS_ioprio_set
+        /* IOPRIO_WHO_PROCESS (1) with pid 0 sets the priority of the calling thread */
+        if (syscall(SYS_ioprio_set, 1, 0, conf->worker_ioprio) == -1) {
+            log_msg(LOG_LEVEL_WARNING, "%s: failed to set I/O priority of worker thread: %s", whoami, strerror(errno));
+        } else {
+            log_msg(LOG_LEVEL_THREAD, "%10s: set I/O priority to %d", whoami, conf->worker_ioprio);
+        }
+#else
+        log_msg(LOG_LEVEL_NOTICE, "%s: ioprio_set() is not available, ignore 'worker_ioprio' option", whoami);
+#endif
+    }
+    if (conf->worker_nice) {
+#ifdef SYS_gettid
+        /* on Linux the nice level is a per thread attribute */
+        if (setpriority(PRIO_PROCESS, syscall(SYS_gettid), conf->worker_nice) == -1) {
+            log_msg(LOG_LEVEL_WARNING, "%s: failed to set nice level of worker thread: %s", whoami, strerror(errno));
+        } else {
+            log_msg(LOG_LEVEL_THREAD, "%10s: set nice level to %d", whoami, conf->worker_nice);
+        }
+#else
+        log_msg(LOG_LEVEL_NOTICE, "%s: per thread nice level is not supported, ignore 'worker_nice' option", whoami);
+#endif
+    }
+}
@@ -22,6 +22,8 @@
 #include "config.h"
 #include <stdlib.h>
 #include <string.h>
+#include <pthread.h>
+#include <unistd.h>
 #include <sys/types.h>
 #include "attributes.h"
 #include "db_line.h"
@@ -41,6 +43,363 @@
 #include <gcrypt.h>
 #endif
 
+/* hashsums not calculated by mhash or gcrypt (sampled: see calc_hashsums()) */
+#define BUILTIN_HASHES (ATTR(attr_merkle)|ATTR(attr_blake3)|ATTR(attr_xxh128)|ATTR(attr_sampled))
+
+/*
+  Merkle tree hashsum: the file is split into MERKLE_CHUNK_SIZE chunks,
+  each chunk is hashed independently (SHA-256 over 0x00 and the chunk) and
+  the chunk hashes are combined in a binary tree (SHA-256 over 0x01 and
+  both child hashes) as in RFC 6962, section 2.1. An empty file has no
+  chunks, its hash is the SHA-256 of the empty string. The subtrees completed
+  so far are kept on a stack, so the tree is built while streaming.
+ */
+
+#define MERKLE_CHUNK_SIZE 1048576
+#define MERKLE_HASH_LENGTH 32
+#define MERKLE_MAX_DEPTH 64
+
+#ifdef WITH_GCRYPT
+typedef gcry_md_hd_t merkle_ctx;
+#endif
+#ifdef WITH_MHASH
+typedef MHASH merkle_ctx;
+#endif
+
+typedef struct merkle_node {
+  unsigned char hash[MERKLE_HASH_LENGTH];
+  unsigned long long leaves;
+} merkle_node;
+
+struct md_merkle {
+  merkle_ctx chunk;
+  bool chunk_open;
+  size_t chunk_length;
+  merkle_node stack[MERKLE_MAX_DEPTH];
+  int depth;
+  /* chunk hashes of a block hashed in parallel */
+  unsigned char (*block_leaves)[MERKLE_HASH_LENGTH];
+  size_t block_leaves_size;
+};
+
+static merkle_ctx merkle_init(void) {
+  merkle_ctx ctx;
+#ifdef WITH_GCRYPT
+  if(gcry_md_open(&ctx,algorithms[hash_merkle],0)!=GPG_ERR_NO_ERROR){
+      log_msg(LOG_LEVEL_ERROR,"gcrypt_md_open failed");
+      exit(IO_ERROR);
+  }
+#endif
+#ifdef WITH_MHASH
+  ctx=mhash_init(algorithms[hash_merkle]);
+  if (ctx==MHASH_FAILED) {
+      log_msg(LOG_LEVEL_ERROR,"mhash_init failed");
+      exit(IO_ERROR);
+  }
+#endif
+  return ctx;
+}
+
+static void merkle_write(merkle_ctx ctx, void* data, size_t size) {
+  if (size == 0) {
+      return;
+  }
+#ifdef WITH_GCRYPT
+  gcry_md_write(ctx, data, size);
+#endif
+#ifdef WITH_MHASH
+  mhash(ctx, data, size);
+#endif
+}
+
+static merkle_ctx merkle_open(unsigned char prefix) {
+  merkle_ctx ctx = merkle_init();
+  merkle_write(ctx, &prefix, 1);
+  return ctx;
+}
+
+/* closes ctx */
+static void merkle_final(merkle_ctx ctx, unsigned char *hash) {
+#ifdef WITH_GCRYPT
+  gcry_md_final(ctx);
+  memcpy(hash, gcry_md_read(ctx, algorithms[hash_merkle]), MERKLE_HASH_LENGTH);
+  gcry_md_close(ctx);
+#endif
+#ifdef WITH_MHASH
+  mhash_deinit(ctx, hash);
+#endif
+}
+
+static void merkle_leaf(unsigned char *hash, void* data, size_t size) {
+  merkle_ctx ctx = merkle_open(0x00);
+  merkle_write(ctx, data, size);
+  merkle_final(ctx, hash);
+}
+
+static void merkle_node_hash(unsigned char *hash, unsigned char *left, unsigned char *right) {
+  merkle_ctx ctx = merkle_open(0x01);
+  merkle_write(ctx, left, MERKLE_HASH_LENGTH);
+  merkle_write(ctx, right, MERKLE_HASH_LENGTH);
+  merkle_final(ctx, hash);
+}
+
+static void merkle_push(struct md_merkle *m, unsigned char *leaf) {
+  merkle_node *top = &m->stack[m->depth++];
+  memcpy(top->hash, leaf, MERKLE_HASH_LENGTH);
+  top->leaves = 1;
+  /* merge complete subtrees of equal size */
+  while (m->depth > 1 && m->stack[m->depth-2].leaves == top->leaves) {
+      merkle_node *left = &m->stack[m->depth-2];
+      merkle_node_hash(left->hash, left->hash, top->hash);
+      left->leaves *= 2;
+      m->depth--;
+      top = left;
+  }
+}
+
+static void merkle_update(struct md_merkle *m, char* data, size_t size) {
+  while (size > 0) {
+      if (!m->chunk_open) {
+          m->chunk = merkle_open(0x00);
+          m->chunk_open = true;
+          m->chunk_length = 0;
+      }
+      size_t n = MERKLE_CHUNK_SIZE - m->chunk_length;
+      if (size < n) {
+          n = size;
+      }
+      merkle_write(m->chunk, data, n);
+      m->chunk_length += n;
+      data += n;
+      size -= n;
+      if (m->chunk_length == MERKLE_CHUNK_SIZE) {
+          unsigned char leaf[MERKLE_HASH_LENGTH];
+          merkle_final(m->chunk, leaf);
+          m->chunk_open = false;
+          merkle_push(m, leaf);
+      }
+  }
+}
+
+/* hash is NULL to discard the state */
+static void merkle_close(struct md_merkle *m, unsigned char *hash) {
+  unsigned char leaf[MERKLE_HASH_LENGTH];
+  if (m->chunk_open) {
+      merkle_final(m->chunk, leaf);
+      m->chunk_open = false;
+      merkle_push(m, leaf);
+  } else if (m->depth == 0) {
+      /* empty file: hash of the empty tree (RFC 6962, section 2.1) */
+      merkle_final(merkle_init(), leaf);
+      merkle_push(m, leaf);
+  }
+  /* fold the remaining subtrees from right to left */
+  while (m->depth > 1) {
+      merkle_node *left = &m->stack[m->depth-2];
+      merkle_node_hash(left->hash, left->hash, m->stack[m->depth-1].hash);
+      m->depth--;
+  }
+  if (hash) {
+      memcpy(hash, m->stack[0].hash, MERKLE_HASH_LENGTH);
+  }
+  m->depth = 0;
+}
+
+/*
+  Parallel hashsum calculation: each hashsum of a parallel md_container
+  has its own library handle. update_md() hands the block over to a
+  process-wide pool of helper threads (one less than the online CPUs,
+  shared by all containers) as a batch of jobs (one per hashsum and one
+  per complete merkle chunk), takes jobs of its batch itself and waits
+  until all jobs of the batch are done.
+ */
+
+/* smaller blocks are hashed on the calling thread */
+#define MD_PARALLEL_MIN_SIZE 65536
+
+struct md_batch {
+  struct md_container *md;
+  void *data;
+  ssize_t size;
+  char *merkle_data;
+  HASHSUM hashsum_jobs[num_hashes];
+  int num_hashsum_jobs;
+  int next_job;
+  int num_jobs;
+  int pending;
+  pthread_cond_t done_cond;
+  struct md_batch *next;
+};
+
+static struct {
+  pthread_mutex_t mutex;
+  pthread_cond_t batch_cond;
+  /* batches with jobs not yet taken */
+  struct md_batch *head;
+  struct md_batch *tail;
+  long num_helpers;
+} md_pool = { PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, NULL, NULL, 0 };
+static pthread_once_t md_pool_once = PTHREAD_ONCE_INIT;
+
+static void update_hashsum(struct md_container* md, HASHSUM i, void* data, ssize_t size) {
+  if (md->hw_attr&ATTR(hashsums[i].attribute)) {
+      hw_hash_update(&md->hw_hash[i], data, size);
+      return;
+  }
+#ifdef WITH_BLAKE3
+  if (i == hash_blake3) {
+      if (md->builtin_attr&ATTR(attr_blake3)) {
+          blake3_hasher_update(&md->blake3, data, size);
+      }
+      return;
+  }
+#endif
+#ifdef WITH_XXHASH
+  if (i == hash_xxh128) {
+      if (md->builtin_attr&ATTR(attr_xxh128)) {
+          XXH3_128bits_update(md->xxh3, data, size);
+      }
+      return;
+  }
+#endif
+#ifdef WITH_MHASH
+  if(md->mhash_mdh[i] != MHASH_FAILED){
+      mhash(md->mhash_mdh[i], data, size);
+  }
+#endif
+#ifdef WITH_GCRYPT
+  if (md->calc_attr&ATTR(hashsums[i].attribute)) {
+      gcry_md_write(md->parallel_mdh[i], data, size);
+  }
+#endif
+}
+
+/* called with the pool mutex locked, returns with the mutex locked */
+static void run_md_job(struct md_batch *b) {
+  int job = b->next_job++;
+  if (b->next_job == b->num_jobs) {
+      /* all jobs taken, remove the batch from the (short) list */
+      struct md_batch *prev = NULL;
+      for (struct md_batch *i = md_pool.head ; i != b ; i = i->next) {
+          prev = i;
+      }
+      if (prev) {
+          prev->next = b->next;
+      } else {
+          md_pool.head = b->next;
+      }
+      if (md_pool.tail == b) {
+          md_pool.tail = prev;
+      }
+  }
+  pthread_mutex_unlock(&md_pool.mutex);
+
+  struct md_container *md = b->md;
+  if (job < b->num_hashsum_jobs) {
+      update_hashsum(md, b->hashsum_jobs[job], b->data, b->size);
+  } else {
+      int chunk = job - b->num_hashsum_jobs;
+      merkle_leaf(md->merkle->block_leaves[chunk], b->merkle_data + (size_t) chunk*MERKLE_CHUNK_SIZE, MERKLE_CHUNK_SIZE);
+  }
+
+  pthread_mutex_lock(&md_pool.mutex);
+  if (--b->pending == 0) {
+      pthread_cond_signal(&b->done_cond);
+  }
+}
+
+static void *md_helper_thread( __attribute__((unused)) void *arg) {
+  pthread_mutex_lock(&md_pool.mutex);
+  while (true) {
+      while (md_pool.head == NULL) {
+          pthread_cond_wait(&md_pool.batch_cond, &md_pool.mutex);
+      }
+      run_md_job(md_pool.head);
+  }
+  return NULL;
+}
+
+static void start_md_pool(void) {
+  long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  /* the calling threads take jobs as well */
+  while (md_pool.num_helpers < cpus - 1) {
+      pthread_t thread;
+      if (pthread_create(&thread, NULL, &md_helper_thread, NULL) != 0) {
+          log_msg(LOG_LEVEL_WARNING, "failed to start hashsum thread (%ld hashsum thread(s) started)", md_pool.num_helpers);
+          break;
+      }
+      /* the helper threads run until the process exits */
+      pthread_detach(thread);
+      md_pool.num_helpers++;
+  }
+  log_msg(LOG_LEVEL_THREAD, "started %ld hashsum thread(s)", md_pool.num_helpers);
+}
+
+static void update_md_parallel(struct md_container* md, char* data, ssize_t size) {
+  struct md_merkle *m = md->merkle;
+  size_t merkle_chunks = 0;
+  char *merkle_data = data;
+  if (m) {
+      /* complete the current chunk first */
+      if (m->chunk_open) {
+          size_t head = MERKLE_CHUNK_SIZE - m->chunk_length;
+          merkle_update(m, data, (size_t) size < head ? (size_t) size : head);
+          merkle_data += (size_t) size < head ? (size_t) size : head;
+      }
+      merkle_chunks = (size - (merkle_data - data)) / MERKLE_CHUNK_SIZE;
+      if (merkle_chunks > m->block_leaves_size) {
+          free(m->block_leaves);
+          m->block_leaves = checked_malloc(merkle_chunks * MERKLE_HASH_LENGTH); /* freed in free_md */
+          m->block_leaves_size = merkle_chunks;
+      }
+  }
+
+  struct md_batch b;
+  b.md = md;
+  b.data = data;
+  b.size = size;
+  b.merkle_data = merkle_data;
+  b.num_hashsum_jobs = 0;
+  for (HASHSUM i = 0 ; i < num_hashes ; ++i) {
+      if ((md->calc_attr|(md->builtin_attr&~ATTR(attr_merkle)))&ATTR(hashsums[i].attribute)) {
+          b.hashsum_jobs[b.num_hashsum_jobs++] = i;
+      }
+  }
+  b.next_job = 0;
+  b.num_jobs = b.num_hashsum_jobs + merkle_chunks;
+  b.pending = b.num_jobs;
+  b.next = NULL;
+
+  if (b.num_jobs) {
+      pthread_cond_init(&b.done_cond, NULL);
+      pthread_mutex_lock(&md_pool.mutex);
+      if (md_pool.tail) {
+          md_pool.tail->next = &b;
+      } else {
+          md_pool.head = &b;
+      }
+      md_pool.tail = &b;
+      pthread_cond_broadcast(&md_pool.batch_cond);
+      /* take the jobs of this batch only, so the caller never waits for other files */
+      while (b.next_job < b.num_jobs) {
+          run_md_job(&b);
+      }
+      while (b.pending) {
+          pthread_cond_wait(&b.done_cond, &md_pool.mutex);
+      }
+      pthread_mutex_unlock(&md_pool.mutex);
+      pthread_cond_destroy(&b.done_cond);
+  }
+
+  if (m) {
+      for (size_t i = 0 ; i < merkle_chunks ; ++i) {
+          merkle_push(m, m->block_leaves[i]);
+      }
+      char *tail = merkle_data + merkle_chunks * MERKLE_CHUNK_SIZE;
+      merkle_update(m, tail, size - (tail - data));
+  }
+}
+
 /*
   Initialise md_container according its todo_attr field
  */
@@ -57,10 +416,13 @@ int init_md(struct md_container* md, const char *filename) {
     We don't have calculator for this yet :)
   */
   md->calc_attr=0;
+  md->builtin_attr=0;
+  md->hw_attr = md->todo_attr&hw_hash_attrs();
+  DB_ATTR_TYPE library_attr = md->todo_attr&~(BUILTIN_HASHES|md->hw_attr);
 #ifdef WITH_MHASH
    for (HASHSUM i = 0 ; i < num_hashes ; ++i) {
        DB_ATTR_TYPE h = ATTR(hashsums[i].attribute);
-       if (h&md->todo_attr) {
+       if (h&library_attr) {
            md->mhash_mdh[i]=mhash_init(algorithms[i]);
            if (md->mhash_mdh[i]!=MHASH_FAILED) {
                md->calc_attr|=h;
@@ -74,6 +436,19 @@ int init_md(struct md_container* md, const char *filename) {
    }
 #endif 
 #ifdef WITH_GCRYPT
+  if (md->parallel) {
+   for (HASHSUM i = 0 ; i < num_hashes ; ++i) {
+        DB_ATTR_TYPE h = ATTR(hashsums[i].attribute);
+            if (h&library_attr) {
+                if(gcry_md_open(&md->parallel_mdh[i],algorithms[i],0)==GPG_ERR_NO_ERROR){
+                    md->calc_attr|=h;
+                } else {
+                    log_msg(LOG_LEVEL_WARNING,"%s: gcry_md_open (%s) failed for '%s'", filename, attributes[hashsums[i].attribute].db_name, filename);
+                    md->todo_attr&=~h;
+                }
+            }
+   }
+  } else {
 	if(gcry_md_open(&md->mdh,0,0)!=GPG_ERR_NO_ERROR){
 		log_msg(LOG_LEVEL_ERROR,"gcrypt_md_open failed");
 		exit(IO_ERROR);
@@ -81,7 +456,7 @@ int init_md(struct md_container* md, const char *filename) {
 
    for (HASHSUM i = 0 ; i < num_hashes ; ++i) {
         DB_ATTR_TYPE h = ATTR(hashsums[i].attribute);
-            if (h&md->todo_attr) {
+            if (h&library_attr) {
                 if(gcry_md_enable(md->mdh,algorithms[i])==GPG_ERR_NO_ERROR){
                     md->calc_attr|=h;
                 } else {
@@ -89,14 +464,99 @@ int init_md(struct md_container* md, const char *filename) {
                     md->todo_attr&=~h;
                 }
             }
+   }
+  }
+#endif
+  md->merkle = NULL;
+  if (md->todo_attr&ATTR(attr_merkle)) {
+      md->merkle = checked_malloc(sizeof(struct md_merkle)); /* freed in free_md */
+      memset(md->merkle, 0, sizeof(struct md_merkle));
+      md->builtin_attr|=ATTR(attr_merkle);
+  }
+  for (HASHSUM i = 0 ; i < num_hashes ; ++i) {
+      if (md->hw_attr&ATTR(hashsums[i].attribute)) {
+          hw_hash_init(&md->hw_hash[i], i);
+      }
+  }
+  md->builtin_attr|=md->hw_attr;
+#ifdef WITH_BLAKE3
+  if (md->todo_attr&ATTR(attr_blake3)) {
+      blake3_hasher_init(&md->blake3);
+      md->builtin_attr|=ATTR(attr_blake3);
+  }
+#endif
+#ifdef WITH_XXHASH
+  if (md->todo_attr&ATTR(attr_xxh128)) {
+      md->xxh3 = XXH3_createState();
+      if (md->xxh3 == NULL) {
+          log_msg(LOG_LEVEL_ERROR, "%s: XXH3_createState() failed", filename);
+          exit(MEMORY_ALLOCATION_FAILURE);
+      }
+      XXH3_128bits_reset(md->xxh3);
+      md->builtin_attr|=ATTR(attr_xxh128);
   }
 #endif
+  if (md->parallel) {
+      pthread_once(&md_pool_once, start_md_pool);
+  }
   char *str;
-  log_msg(LOG_LEVEL_DEBUG, "%s> initialized md_container: %s (%p)", filename, str = diff_attributes(0, md->calc_attr), (void*) md);
+  log_msg(LOG_LEVEL_DEBUG, "%s> initialized md_container: %s (%p)", filename, str = diff_attributes(0, md->calc_attr|md->builtin_attr), (void*) md);
   free(str);
   return RETOK;
 }
 
+/*
+  Prepare a closed md_container for the next file with the same hashsums.
+  gcrypt handles are reused (they are reset by close_md), mhash has no
+  reset function so its handles are initialised again.
+ */
+
+int reset_md(struct md_container* md, const char *filename) {
+#ifdef WITH_MHASH
+   for (HASHSUM i = 0 ; i < num_hashes ; ++i) {
+       DB_ATTR_TYPE h = ATTR(hashsums[i].attribute);
+       if (h&md->calc_attr) {
+           md->mhash_mdh[i]=mhash_init(algorithms[i]);
+           if (md->mhash_mdh[i]==MHASH_FAILED) {
+               log_msg(LOG_LEVEL_WARNING,"%s: mhash_init (%s) failed for '%s'", filename, attributes[hashsums[i].attribute].db_name, filename);
+               md->calc_attr&=~h;
+           }
+       }
+   }
+#endif
+  log_msg(LOG_LEVEL_DEBUG, "%s> reset md_container (%p)", filename, (void*) md);
+  return RETOK;
+}
+
+/*
+  Release the library handles of a closed md_container.
+ */
+
+void free_md(struct md_container* md) {
+#ifdef WITH_GCRYPT
+  if (md->parallel) {
+      for (HASHSUM i = 0 ; i < num_hashes ; ++i) {
+          if (md->calc_attr&ATTR(hashsums[i].attribute)) {
+              gcry_md_close(md->parallel_mdh[i]);
+          }
+      }
+  } else {
+      gcry_md_close(md->mdh);
+  }
+#endif
+  if (md->merkle) {
+      free(md->merkle->block_leaves);
+      free(md->merkle);
+      md->merkle = NULL;
+  }
+#ifdef WITH_XXHASH
+  if (md->builtin_attr&ATTR(attr_xxh128)) {
+      XXH3_freeState(md->xxh3);
+      md->xxh3 = NULL;
+  }
+#endif
+}
+
 /*
   update :)
   Just call this when you have more data.
@@ -111,6 +571,37 @@ int update_md(struct md_container* md,void* data,ssize_t size) {
   }
 #endif
 
+  if (md->parallel) {
+      if (md_pool.num_helpers && size >= MD_PARALLEL_MIN_SIZE) {
+          update_md_parallel(md, data, size);
+      } else {
+          for (HASHSUM i = 0 ; i < num_hashes ; ++i) {
+              update_hashsum(md, i, data, size);
+          }
+          if (md->merkle) {
+              merkle_update(md->merkle, data, size);
+          }
+      }
+      return RETOK;
+  }
+  if (md->merkle) {
+      merkle_update(md->merkle, data, size);
+  }
+  for (HASHSUM i = 0 ; i < num_hashes ; ++i) {
+      if (md->hw_attr&ATTR(hashsums[i].attribute)) {
+          hw_hash_update(&md->hw_hash[i], data, size);
+      }
+  }
+#ifdef WITH_BLAKE3
+  if (md->builtin_attr&ATTR(attr_blake3)) {
+      blake3_hasher_update(&md->blake3, data, size);
+  }
+#endif
+#ifdef WITH_XXHASH
+  if (md->builtin_attr&ATTR(attr_xxh128)) {
+      XXH3_128bits_update(md->xxh3, data, size);
+  }
+#endif
 #ifdef WITH_MHASH
   for (HASHSUM i = 0 ; i < num_hashes ; ++i) {
       if(md->mhash_mdh[i] != MHASH_FAILED){
@@ -144,6 +635,17 @@ int close_md(struct md_container* md, md_hashsums * hs, const char *filename) {
   }
 #endif /* WITH_MHASH */
 #ifdef WITH_GCRYPT
+  if (md->parallel) {
+      for (HASHSUM i = 0 ; i < num_hashes ; ++i) {
+          if (md->calc_attr&ATTR(hashsums[i].attribute)) {
+              gcry_md_final(md->parallel_mdh[i]);
+              if (hs) {
+                  memcpy(hs->hashsums[i],gcry_md_read(md->parallel_mdh[i], algorithms[i]), hashsums[i].length);
+              }
+              gcry_md_reset(md->parallel_mdh[i]);
+          }
+      }
+  } else {
   gcry_md_final(md->mdh); 
 
   if (hs) {
@@ -155,6 +657,7 @@ int close_md(struct md_container* md, md_hashsums * hs, const char *filename) {
   }
 
   gcry_md_reset(md->mdh);
+  }
 #endif  
 
 #ifdef WITH_MHASH
@@ -163,9 +666,38 @@ int close_md(struct md_container* md, md_hashsums * hs, const char *filename) {
           mhash_deinit(md->mhash_mdh[i],hs?hs->hashsums[i]:NULL);
       }
   }
+#endif
+  if (md->merkle) {
+      merkle_close(md->merkle, hs?hs->hashsums[hash_merkle]:NULL);
+  }
+  for (HASHSUM i = 0 ; i < num_hashes ; ++i) {
+      if (md->hw_attr&ATTR(hashsums[i].attribute)) {
+          if (hs) {
+              hw_hash_final(&md->hw_hash[i], i, hs->hashsums[i]);
+          }
+          hw_hash_init(&md->hw_hash[i], i);
+      }
+  }
+#ifdef WITH_BLAKE3
+  if (md->builtin_attr&ATTR(attr_blake3)) {
+      if (hs) {
+          blake3_hasher_finalize(&md->blake3, hs->hashsums[hash_blake3], hashsums[hash_blake3].length);
+      }
+      blake3_hasher_reset(&md->blake3);
+  }
+#endif
+#ifdef WITH_XXHASH
+  if (md->builtin_attr&ATTR(attr_xxh128)) {
+      if (hs) {
+          XXH128_canonical_t canonical;
+          XXH128_canonicalFromHash(&canonical, XXH3_128bits_digest(md->xxh3));
+          memcpy(hs->hashsums[hash_xxh128], canonical.digest, hashsums[hash_xxh128].length);
+      }
+      XXH3_128bits_reset(md->xxh3);
+  }
 #endif
   if (hs) {
-      hs->attrs = md->calc_attr;
+      hs->attrs = md->calc_attr|md->builtin_attr;
   }
   return RETOK;
 }
@@ -41,6 +41,11 @@ struct queue_s {
     qnode_t *head;
     qnode_t *tail;
 
+    /* sorted queues are kept as binary min-heap */
+    void **heap;
+    size_t heap_len;
+    size_t heap_size;
+
     pthread_mutex_t mutex;
     pthread_cond_t cond;
 
@@ -57,6 +62,10 @@ queue_ts_t *queue_init(int (*sort_func) (const void*, const void*)) {
     queue->head = NULL;
     queue->tail = NULL;
 
+    queue->heap = NULL;
+    queue->heap_len = 0;
+    queue->heap_size = 0;
+
     queue->sort_func = sort_func;
 
     log_msg(queue_log_level, "queue(%p): create new queue (sorted: %s)", (void*) queue, btoa(sort_func != NULL));
@@ -65,12 +74,67 @@ queue_ts_t *queue_init(int (*sort_func) (const void*, const void*)) {
 
 void queue_free(queue_ts_t *queue) {
     if (queue) {
+        free(queue->heap);
         free(queue);
     }
 }
 
+static bool queue_is_empty(queue_ts_t * const queue) {
+    return queue->sort_func ? queue->heap_len == 0 : queue->head == NULL;
+}
+
+static void heap_swap(void **heap, size_t i, size_t j) {
+    void *tmp = heap[i];
+    heap[i] = heap[j];
+    heap[j] = tmp;
+}
+
+static bool heap_push(queue_ts_t * const queue, void * const data) {
+    if (queue->heap_len == queue->heap_size) {
+        queue->heap_size = queue->heap_size ? 2 * queue->heap_size : 64;
+        queue->heap = checked_realloc(queue->heap, queue->heap_size * sizeof(void*)); /* freed in queue_free */
+    }
+    size_t i = queue->heap_len++;
+    queue->heap[i] = data;
+    while (i > 0 && queue->sort_func(queue->heap[i], queue->heap[(i-1)/2]) < 0) {
+        heap_swap(queue->heap, i, (i-1)/2);
+        i = (i-1)/2;
+    }
+    log_msg(queue_log_level, "queue(%p): add payload %p at position %zu of %zu", (void*) queue, (void*) data, i, queue->heap_len);
+    return i == 0;
+}
+
+static void *heap_pop(queue_ts_t * const queue) {
+    if (queue->heap_len == 0) {
+        return NULL;
+    }
+    void *data = queue->heap[0];
+    queue->heap[0] = queue->heap[--queue->heap_len];
+    size_t i = 0;
+    while (1) {
+        size_t min = i, left = 2*i+1, right = 2*i+2;
+        if (left < queue->heap_len && queue->sort_func(queue->heap[left], queue->heap[min]) < 0) {
+            min = left;
+        }
+        if (right < queue->heap_len && queue->sort_func(queue->heap[right], queue->heap[min]) < 0) {
+            min = right;
+        }
+        if (min == i) {
+            break;
+        }
+        heap_swap(queue->heap, i, min);
+        i = min;
+    }
+    log_msg(queue_log_level, "queue(%p): return first payload %p", (void*) queue, (void*) data);
+    return data;
+}
+
 bool queue_enqueue(queue_ts_t * const queue, void * const data) {
-    qnode_t *new, *current;
+    if (queue->sort_func) {
+        return heap_push(queue, data);
+    }
+
+    qnode_t *new;
     new = checked_malloc(sizeof(qnode_t)); /* freed in queue_dequeue */
     new->data = data;
 
@@ -84,36 +148,6 @@ bool queue_enqueue(queue_ts_t * const queue, void * const data) {
         new->prev = NULL;
         new_head_tail = true;
         log_msg(queue_log_level, "queue(%p): add node %p with payload %p as new head and new tail", (void*) queue, (void*) new, (void*) new->data);
-    } else if (queue->sort_func) {
-        /* add element in sorted, non-empty queue (use insertion sort) */
-        current = queue->head;
-        if (queue->sort_func(new->data, current->data) <= 0) {
-            /* new node is new head */
-            queue->head = new;
-            current->next = new;
-            new->prev = current;
-            new->next = NULL;
-            log_msg(queue_log_level, "queue(%p): add node %p with payload %p as new head", (void*) queue, (void*) new, (void*) new->data);
-        } else {
-            while (current != NULL && queue->sort_func(new->data, current->data) > 0) {
-                current = current->prev;
-            }
-            if (current == NULL) {
-                /* new node is new tail */
-                (queue->tail)->prev = new;
-                new->next = queue->tail;
-                new->prev = NULL;
-                queue->tail = new;
-                log_msg(queue_log_level, "queue(%p): add node %p with payload %p as new tail", (void*) queue, (void*) new, (void*) new->data);
-            } else {
-                /* new node is inner node */
-                (current->next)->prev = new;
-                new->next = current->next;
-                current->next = new;
-                new->prev = current;
-                log_msg(queue_log_level, "queue(%p): add node %p with payload %p as inner element between %p and %p", (void*) queue, (void*) new, (void*) new->data, (void*) new->prev, (void*) new->next);
-            }
-        }
     } else {
         /* new node is new tail */
         (queue->tail)->prev = new;
@@ -126,6 +160,10 @@ bool queue_enqueue(queue_ts_t * const queue, void * const data) {
 }
 
 void *queue_dequeue(queue_ts_t * const queue) {
+    if (queue->sort_func) {
+        return heap_pop(queue);
+    }
+
     qnode_t *head;
     void *data = NULL;
 
@@ -142,6 +180,28 @@ void *queue_dequeue(queue_ts_t * const queue) {
     return data;
 }
 
+/* sorted queues have no tail, the first element is returned instead */
+void *queue_dequeue_tail(queue_ts_t * const queue) {
+    if (queue->sort_func) {
+        return heap_pop(queue);
+    }
+
+    qnode_t *tail;
+    void *data = NULL;
+
+    if ((tail = queue->tail) != NULL) {
+        if ((queue->tail = tail->next) == NULL) {
+            queue->head = NULL;
+        } else {
+            (queue->tail)->prev = NULL;
+        }
+        log_msg(queue_log_level, "queue(%p): return tail node %p with payload %p", (void*) queue, (void*) tail, (void*) tail->data);
+        data = tail->data;
+        free(tail);
+    }
+    return data;
+}
+
 queue_ts_t *queue_ts_init(int (*sort_func) (const void*, const void*)) {
     queue_ts_t *queue = checked_malloc (sizeof(queue_ts_t));
 
@@ -158,6 +218,10 @@ queue_ts_t *queue_ts_init(int (*sort_func) (const void*, const void*)) {
     queue->head = NULL;
     queue->tail = NULL;
 
+    queue->heap = NULL;
+    queue->heap_len = 0;
+    queue->heap_size = 0;
+
     queue->sort_func = sort_func;
 
     pthread_mutex_unlock(&queue->mutex);
@@ -187,24 +251,16 @@ bool queue_ts_enqueue(queue_ts_t * const queue, void * const data, const char *w
 }
 
 void *queue_ts_dequeue_wait(queue_ts_t * const queue, const char *whoami) {
-    qnode_t *head;
     void *data = NULL;
     pthread_mutex_lock(&queue->mutex);
 
-    while ((head = queue->head) == NULL && queue->release == false){
+    while (queue_is_empty(queue) && queue->release == false){
         log_msg(LOG_LEVEL_THREAD, "%10s: queue(%p): waiting for new node", whoami, (void*) queue);
         pthread_cond_wait(&queue->cond, &queue->mutex);
-        log_msg(LOG_LEVEL_THREAD, "%10s: queue(%p): got broadcast (head: %p)", whoami, (void*) queue, (void*) queue->head);
+        log_msg(LOG_LEVEL_THREAD, "%10s: queue(%p): got broadcast (empty: %s)", whoami, (void*) queue, btoa(queue_is_empty(queue)));
     }
-    if (head != NULL) {
-        if ((queue->head = head->prev) == NULL) {
-            queue->tail = NULL;
-        } else {
-            (queue->head)->next = NULL;
-        }
-        data = head->data;
-        log_msg(queue_log_level, "queue(%p): return head node %p with payload %p", (void*) queue, (void*) head, (void*) head->data);
-        free(head);
+    if (!queue_is_empty(queue)) {
+        data = queue_dequeue(queue);
     } else {
         log_msg(queue_log_level, "queue(%p): return NULL from empty, released queue", (void*) queue);
     }
@@ -212,6 +268,20 @@ void *queue_ts_dequeue_wait(queue_ts_t * const queue, const char *whoami) {
     return data;
 }
 
+void *queue_ts_dequeue(queue_ts_t * const queue) {
+    pthread_mutex_lock(&queue->mutex);
+    void *data = queue_dequeue(queue);
+    pthread_mutex_unlock(&queue->mutex);
+    return data;
+}
+
+void *queue_ts_dequeue_tail(queue_ts_t * const queue) {
+    pthread_mutex_lock(&queue->mutex);
+    void *data = queue_dequeue_tail(queue);
+    pthread_mutex_unlock(&queue->mutex);
+    return data;
+}
+
 void queue_ts_release(queue_ts_t * const queue, const char *whoami) {
     pthread_mutex_lock(&queue->mutex);
     queue->release = true;
@@ -26,6 +26,7 @@
 #include "db.h"
 #include "db_config.h"
 #include "db_line.h"
+#include "gen_list.h"
 #include "report.h"
 #include "seltree.h"
 #include "stdbool.h"
@@ -249,6 +250,10 @@ static void print_report_report_options_json(report_t *report) {
 }
 
 static void print_report_summary_json(report_t *report) {
+    long nreused = get_num_reused_hashsums();
+    if (nreused) {
+        report_printf(report, JSON_FMT_LONG, 2, ' ', "number_of_reused_hashsums", nreused);
+    }
     report_printf(report, JSON_FMT_OBJECT_BEGIN, 2, ' ', "number_of_entries");
     if (conf->action&(DO_COMPARE|DO_DIFF) && (report->nadd||report->nrem||report->nchg)) {
         report_printf(report, JSON_FMT_LONG, 4, ' ', "total", report->ntotal);
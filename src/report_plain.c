@@ -28,6 +28,7 @@
 #include "db.h"
 #include "db_config.h"
 #include "db_line.h"
+#include "gen_list.h"
 #include "report.h"
 #include "seltree.h"
 #include "stdbool.h"
@@ -136,6 +137,10 @@ static void print_report_summary_plain(report_t *report) {
     } else {
         report_printf(report, _("\nNumber of entries:\t%li"), report->ntotal);
     }
+    long nreused = get_num_reused_hashsums();
+    if (nreused) {
+        report_printf(report, _("\n\nHashsums of %li unchanged file(s) (same inode, size, mtime and ctime) were reused from the old database (not recalculated)"), nreused);
+    }
 }
 
 static void print_line_plain(report_t* report, char* filename, int node_checked, seltree* node) {
@@ -150,13 +150,19 @@ static seltree *create_seltree_node(char *path, seltree *parent) {
     node->old_data = NULL;
     node->changed_attrs = 0;
 
+    node->old_hashsums = NULL;
+
     return node;
 }
 
 static seltree *_insert_new_node(char *path, seltree *parent) {
-    seltree *node = create_seltree_node(path, parent);
     pthread_mutex_lock(&parent->mutex);
-    parent ->children = tree_insert(parent->children, strrchr(node->path,'/'), (void*)node, (tree_cmp_f) strcmp);
+    /* node may have been created by another scan worker in the meantime */
+    seltree *node = tree_search(parent->children, strrchr(path,'/'), (tree_cmp_f) strcmp);
+    if (node == NULL) {
+        node = create_seltree_node(path, parent);
+        parent ->children = tree_insert(parent->children, strrchr(node->path,'/'), (void*)node, (tree_cmp_f) strcmp);
+    }
     pthread_mutex_unlock(&parent->mutex);
     return node;
 }
@@ -142,3 +142,11 @@ tree_node *tree_walk_next(tree_node *m) {
 void *tree_get_data(tree_node *n) {
     return n->data;
 }
+
+void tree_free(tree_node *n) {
+    if (n != NULL) {
+        tree_free(n->left);
+        tree_free(n->right);
+        free(n);
+    }
+}
@@ -0,0 +1,297 @@
+/*
+ * AIDE (Advanced Intrusion Detection Environment)
+ *
+ * Copyright (C) 2026 Hannes von Haugwitz
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <liburing.h>
+
+#include "aide.h"
+#include "attributes.h"
+#include "hashsum.h"
+#include "io_limit.h"
+#include "md.h"
+#include "do_md.h"
+#include "errorcodes.h"
+#include "log.h"
+#include "util.h"
+#include "uring.h"
+
+/* size of the read buffer of each file in flight */
+#define URING_READ_SIZE 1048576
+
+typedef enum uring_state {
+    URING_FREE = 0,
+    URING_OPEN,
+    URING_STAT,
+    URING_READ,
+    URING_DONE,
+} uring_state;
+
+typedef struct uring_file {
+    uring_state state;
+    void *data;
+    int dirfd;
+    const char *name;
+    char *fullpath;
+    DB_ATTR_TYPE attr;
+    struct stat *old_fs;
+    int flags;
+    int fd;
+    struct statx stx;
+    /* reserved from the per thread hash engine (see do_md.c) */
+    struct md_container *mdc;
+    char *buf;
+    off_t r_size;
+    md_hashsums md_hash;
+} uring_file;
+
+struct uring_engine {
+    struct io_uring ring;
+    uring_file files[URING_FILES];
+    int in_flight;
+    const char *whoami;
+};
+
+uring_engine *uring_engine_init(const char *whoami) {
+    uring_engine *engine = checked_malloc(sizeof(uring_engine)); /* freed in uring_engine_free */
+    memset(engine, 0, sizeof(uring_engine));
+    int ret = io_uring_queue_init(URING_FILES, &engine->ring, 0);
+    if (ret < 0) {
+        log_msg(LOG_LEVEL_NOTICE, "%s: io_uring_queue_init() failed: %s (fall back to blocking I/O)", whoami, strerror(-ret));
+        free(engine);
+        return NULL;
+    }
+    engine->whoami = whoami;
+    log_msg(LOG_LEVEL_THREAD, "%10s: uring: initialized io_uring engine %p", whoami, (void*) engine);
+    return engine;
+}
+
+void uring_engine_free(uring_engine *engine) {
+    if (engine) {
+        io_uring_queue_exit(&engine->ring);
+        for (int i = 0 ; i < URING_FILES ; ++i) {
+            free(engine->files[i].buf);
+        }
+        free(engine);
+    }
+}
+
+bool uring_engine_full(uring_engine *engine) {
+    return engine->in_flight == URING_FILES;
+}
+
+bool uring_engine_empty(uring_engine *engine) {
+    return engine->in_flight == 0;
+}
+
+static struct io_uring_sqe *uring_get_sqe(uring_engine *engine, uring_file *file) {
+    /* each file has at most one pending request, so the ring never overflows */
+    struct io_uring_sqe *sqe = io_uring_get_sqe(&engine->ring);
+    io_uring_sqe_set_data(sqe, file);
+    return sqe;
+}
+
+static void uring_submit_open(uring_engine *engine, uring_file *file) {
+    file->state = URING_OPEN;
+    io_uring_prep_openat(uring_get_sqe(engine, file), file->dirfd, file->name, file->flags, 0);
+}
+
+static void uring_submit_read(uring_engine *engine, uring_file *file) {
+    file->state = URING_READ;
+    io_uring_prep_read(uring_get_sqe(engine, file), file->fd, file->buf, URING_READ_SIZE, file->r_size);
+}
+
+bool uring_engine_add(uring_engine *engine, void *data, int dirfd, const char *name, char *fullpath, DB_ATTR_TYPE attr, struct stat *old_fs) {
+    uring_file *file = NULL;
+    for (int i = 0 ; i < URING_FILES ; ++i) {
+        if (engine->files[i].state == URING_FREE) {
+            file = &engine->files[i];
+            break;
+        }
+    }
+    if (file == NULL) {
+        log_msg(LOG_LEVEL_THREAD, "%10s: uring: no free slot for '%s' (in flight: %d)", engine->whoami, fullpath, engine->in_flight);
+        return false;
+    }
+    if (file->buf == NULL) {
+        file->buf = checked_malloc(URING_READ_SIZE); /* freed in uring_engine_free */
+    }
+    file->data = data;
+    file->dirfd = dirfd;
+    file->name = name;
+    file->fullpath = fullpath;
+    file->attr = attr;
+    file->old_fs = old_fs;
+    /* O_NONBLOCK is cleared after the file type has been checked */
+    file->flags = O_RDONLY|O_NOFOLLOW|O_NONBLOCK|O_NOCTTY|O_CLOEXEC;
+#ifdef HAVE_O_NOATIME
+    file->flags |= O_NOATIME;
+#endif
+    file->fd = -1;
+    file->r_size = 0;
+    file->md_hash.attrs = 0LU;
+    engine->in_flight++;
+    log_msg(LOG_LEVEL_THREAD, "%10s: uring: add '%s' (payload: %p, in flight: %d)", engine->whoami, fullpath, data, engine->in_flight);
+    uring_submit_open(engine, file);
+    return true;
+}
+
+static void uring_close_md(uring_file *file, md_hashsums *hs) {
+    hash_md_close(file->mdc, hs, file->fullpath);
+    file->mdc = NULL;
+}
+
+static void uring_handle_open(uring_engine *engine, uring_file *file, int res) {
+    if (res < 0) {
+#ifdef HAVE_O_NOATIME
+        if (res == -EPERM && file->flags&O_NOATIME) {
+            file->flags &= ~O_NOATIME;
+            uring_submit_open(engine, file);
+            return;
+        }
+#endif
+        log_msg(LOG_LEVEL_WARNING, "hash calculation: open() failed for %s: %s (hashsums could not be calculated)", file->fullpath, strerror(-res));
+        file->state = URING_DONE;
+        return;
+    }
+    file->fd = res;
+    file->state = URING_STAT;
+    io_uring_prep_statx(uring_get_sqe(engine, file), file->fd, "", AT_EMPTY_PATH, STATX_BASIC_STATS, &file->stx);
+}
+
+static void uring_handle_stat(uring_engine *engine, uring_file *file, int res) {
+    file->state = URING_DONE;
+    if (res < 0) {
+        log_msg(LOG_LEVEL_WARNING, "hash calculation: statx() failed for '%s': %s (hashsums could not be calculated)", file->fullpath, strerror(-res));
+        return;
+    }
+    struct stat new_fs;
+    statx2stat(&file->stx, &new_fs);
+    if (hashsum_check_stat(file->fullpath, file->attr, &new_fs, file->old_fs) != RETOK) {
+        return;
+    }
+    int flags = fcntl(file->fd, F_GETFL);
+    if (flags == -1 || fcntl(file->fd, F_SETFL, flags&~O_NONBLOCK) == -1) {
+        log_msg(LOG_LEVEL_WARNING, "hash calculation: fcntl() failed for '%s': %s (hashsums could not be calculated)", file->fullpath, strerror(errno));
+        return;
+    }
+#ifdef HAVE_POSIX_FADVISE
+    if (posix_fadvise(file->fd,0,new_fs.st_size,POSIX_FADV_NOREUSE)!=0) {
+        log_msg(LOG_LEVEL_DEBUG, "%s> uring: posix_fadvise error for '%s': %s", file->fullpath, file->fullpath, strerror(errno));
+    }
+#endif
+    file->mdc = hash_md_get(file->attr, file->fullpath);
+    if (file->mdc == NULL) {
+        log_msg(LOG_LEVEL_WARNING, "hash calculation: init_md() failed for '%s' (hashsums could not be calculated)", file->fullpath);
+        return;
+    }
+    log_msg(LOG_LEVEL_DEBUG, "%s> calculate hashes for '%s'", file->fullpath, file->fullpath);
+    uring_submit_read(engine, file);
+}
+
+static void uring_handle_read(uring_engine *engine, uring_file *file, int res) {
+    if (res == -EINTR || res == -EAGAIN) {
+        uring_submit_read(engine, file);
+        return;
+    }
+    file->state = URING_DONE;
+    if (res < 0) {
+        log_msg(LOG_LEVEL_WARNING, "hash calculation: read() failed for '%s': %s (hashsums could not be calculated)", file->fullpath, strerror(-res));
+        uring_close_md(file, NULL);
+        return;
+    }
+    bool growing = file->attr&ATTR(attr_growing);
+    if (res > 0) {
+        io_limit_read(file->old_fs->st_dev, res);
+        off_t update_md_size = res;
+        if (growing && file->r_size+res > file->old_fs->st_size) {
+            update_md_size = file->old_fs->st_size-file->r_size;
+        }
+        if (update_md(file->mdc, file->buf, update_md_size) != RETOK) {
+            log_msg(LOG_LEVEL_WARNING, "hash calculation: update_md() failed for '%s' (hashsums could not be calculated)", file->fullpath);
+            uring_close_md(file, NULL);
+            return;
+        }
+        hash_drop_cache(file->fd, file->fullpath, file->r_size, res);
+        file->r_size += update_md_size;
+        if (!(growing && file->r_size == file->old_fs->st_size)) {
+            uring_submit_read(engine, file);
+            return;
+        }
+        log_msg(LOG_LEVEL_DEBUG, "hash calculation: stat size (%zi) reached for growing file '%s'", file->old_fs->st_size, file->fullpath);
+    }
+    hash_drop_cache(file->fd, file->fullpath, 0, 0);
+    if (hashsum_check_size(file->fullpath, file->attr, file->old_fs, -1, file->r_size) != RETOK) {
+        uring_close_md(file, NULL);
+    } else {
+        uring_close_md(file, &file->md_hash);
+    }
+}
+
+void *uring_engine_wait(uring_engine *engine, int *filedes, md_hashsums *md_hash) {
+    while (engine->in_flight) {
+        int ret = io_uring_submit(&engine->ring);
+        if (ret < 0 && ret != -EINTR && ret != -EAGAIN && ret != -EBUSY) {
+            log_msg(LOG_LEVEL_ERROR, "%s: io_uring_submit() failed: %s", engine->whoami, strerror(-ret));
+            exit(THREAD_ERROR);
+        }
+        struct io_uring_cqe *cqe;
+        ret = io_uring_wait_cqe(&engine->ring, &cqe);
+        if (ret == -EINTR || ret == -EAGAIN) {
+            continue;
+        } else if (ret < 0) {
+            log_msg(LOG_LEVEL_ERROR, "%s: io_uring_wait_cqe() failed: %s", engine->whoami, strerror(-ret));
+            exit(THREAD_ERROR);
+        }
+        uring_file *file = io_uring_cqe_get_data(cqe);
+        int res = cqe->res;
+        io_uring_cqe_seen(&engine->ring, cqe);
+
+        switch (file->state) {
+            case URING_OPEN:
+                uring_handle_open(engine, file, res);
+                break;
+            case URING_STAT:
+                uring_handle_stat(engine, file, res);
+                break;
+            case URING_READ:
+                uring_handle_read(engine, file, res);
+                break;
+            case URING_FREE:
+            case URING_DONE:
+                break;
+        }
+        if (file->state == URING_DONE) {
+            file->state = URING_FREE;
+            engine->in_flight--;
+            *filedes = file->fd;
+            *md_hash = file->md_hash;
+            log_msg(LOG_LEVEL_THREAD, "%10s: uring: return '%s' (payload: %p, in flight: %d)", engine->whoami, file->fullpath, file->data, engine->in_flight);
+            return file->data;
+        }
+    }
+    return NULL;
+}
@@ -25,6 +25,7 @@
 #include <stdio.h>
 #include <string.h>
 #include <sys/stat.h>
+#include <sys/sysmacros.h>
 #include <ctype.h>
 #include <syslog.h>
 #include <stdbool.h>
@@ -494,3 +495,28 @@ int syslog_facility_lookup(char *s)
 	return(AIDE_SYSLOG_FACILITY);
 }
 #endif
+
+#ifdef HAVE_STATX
+/* fields not in stx_mask are left zeroed */
+void statx2stat(struct statx *stx, struct stat *fs) {
+    memset(fs, 0, sizeof(struct stat));
+#define statx2stat_helper(mask, field, stx_field) if (stx->stx_mask&(mask)) { fs->field = stx->stx_field; }
+    /* device numbers and block size are always returned */
+    fs->st_dev = makedev(stx->stx_dev_major, stx->stx_dev_minor);
+    fs->st_rdev = makedev(stx->stx_rdev_major, stx->stx_rdev_minor);
+    fs->st_blksize = stx->stx_blksize;
+    statx2stat_helper(STATX_TYPE|STATX_MODE, st_mode, stx_mode)
+    statx2stat_helper(STATX_INO, st_ino, stx_ino)
+    statx2stat_helper(STATX_NLINK, st_nlink, stx_nlink)
+    statx2stat_helper(STATX_UID, st_uid, stx_uid)
+    statx2stat_helper(STATX_GID, st_gid, stx_gid)
+    statx2stat_helper(STATX_SIZE, st_size, stx_size)
+    statx2stat_helper(STATX_BLOCKS, st_blocks, stx_blocks)
+    statx2stat_helper(STATX_ATIME, st_atim.tv_sec, stx_atime.tv_sec)
+    statx2stat_helper(STATX_ATIME, st_atim.tv_nsec, stx_atime.tv_nsec)
+    statx2stat_helper(STATX_MTIME, st_mtim.tv_sec, stx_mtime.tv_sec)
+    statx2stat_helper(STATX_MTIME, st_mtim.tv_nsec, stx_mtime.tv_nsec)
+    statx2stat_helper(STATX_CTIME, st_ctim.tv_sec, stx_ctime.tv_sec)
+    statx2stat_helper(STATX_CTIME, st_ctim.tv_nsec, stx_ctime.tv_nsec)
+}
+#endif
@@ -27,6 +27,7 @@ int main (void) {
     SRunner *sr;
 
     sr = srunner_create (make_attributes_suite());
+    srunner_add_suite (sr, make_hw_hash_suite());
 
     srunner_run_all (sr, CK_NORMAL);
     number_failed = srunner_ntests_failed (sr);
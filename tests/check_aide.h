@@ -21,3 +21,4 @@
 #include <check.h>
 
 Suite *make_attributes_suite(void);
+Suite *make_hw_hash_suite(void);
@@ -0,0 +1,181 @@
+/*
+ * AIDE (Advanced Intrusion Detection Environment)
+ *
+ * Copyright (C) 2026 Hannes von Haugwitz
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <check.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "attributes.h"
+#include "hashsum.h"
+#include "hw_hash.h"
+
+/* the tests are skipped if the CPU lacks the instructions */
+
+#define MIB 1048576
+
+typedef struct {
+    const char *message;
+    size_t repeat;
+    const char *sha1;
+    const char *sha256;
+} hw_hash_kat_t;
+
+static hw_hash_kat_t hw_hash_kat_tests[] = {
+    { "", 1, "da39a3ee5e6b4b0d3255bfef95601890afd80709", "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855" },
+    { "abc", 1, "a9993e364706816aba3e25717850c26c9cd0d89d", "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad" },
+    { "a", MIB, "454027d64e3b855735552d42230eea1cbd645fa0", "9bc1b2a288b26af7257a36277ae3816a7d4f16e89c1e7e77d0a5c48bad62b360" },
+};
+
+static int num_hw_hash_kat_tests = sizeof hw_hash_kat_tests / sizeof(hw_hash_kat_t);
+
+/* message i of the multi-buffer batch: byte j is (i+j) % 251 */
+typedef struct {
+    size_t length;
+    const char *sha256;
+} hw_hash_multi_t;
+
+static hw_hash_multi_t hw_hash_multi_tests[HW_HASH_MAX_LANES] = {
+    {       0, "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855" },
+    {       3, "039058c6f2c0cb492c533b0a4d14ef77cc0f78abccced5287d84a1a2011cfb81" },
+    {      55, "1a3b9ee53a15c48c1039dac3402d8adae8b992f040f917d3602c624a53fe1401" },
+    {      56, "1d742f4c8c512b0d2811d426f99ccdc16103332fac6c1ae4ffaa27535b2875bb" },
+    {      63, "664f57310100b1c261aa78f5f78766dd4e808f5c4c5acc63c26f68b83331f958" },
+    {      64, "be54ae13651a5cf3c250eb47b4c03e799ba7374b200f14d864365a638963daa7" },
+    {      65, "5d7af76b0df61aaf693447aa4d4e654f040230a733709e11fe2892f3c60d9078" },
+    {     119, "d8a02ed9ca502e02772158c0492f3208490b2319b68891312cbafb161b6d5f6a" },
+    {     120, "0456de925698587f67dc1f1889ee0de1aaa54f929f28cb5470c4b44b1db35f2c" },
+    {     127, "31d2797e5297520d7d7145e905a45067ed6d8e1e03ad0459c5b918aff15efa7d" },
+    {     128, "2e51117240bdaa7d4e4938991a242c67d28b9a32d0268a6fe5fde85bd2fff9ae" },
+    {    1000, "83384eacd9f48e26fb00a4c3bdec9eb4a098cd24f4f78ec2a4d71c1c924528ca" },
+    {    4096, "0826f09db80e8befe608deffe64edd48c3a4f7c6612ae3d7af5b031c7b9287d8" },
+    {   12345, "38a1e34397f42bc6b7d67ea03e73e4d5c9bc86090c0728f2719b75b2570355d4" },
+    {   65537, "438b308f03e9c88f137cb07c0e6e62c3d9cd5243b7b8c81d0095e6f85f421ba1" },
+    {     MIB, "358df49d99424b27656a5ebbab0d96eba22e00f0b3db7786864dbce8d24a5340" },
+};
+
+static void to_hex(const unsigned char *digest, int length, char *hex) {
+    for (int i = 0 ; i < length ; ++i) {
+        snprintf(&hex[2*i], 3, "%02x", digest[i]);
+    }
+}
+
+static unsigned char *kat_message(hw_hash_kat_t *kat, size_t *length) {
+    size_t len = strlen(kat->message);
+    *length = len * kat->repeat;
+    unsigned char *message = malloc(*length + 1);
+    for (size_t i = 0 ; i < kat->repeat ; ++i) {
+        memcpy(&message[i * len], kat->message, len);
+    }
+    return message;
+}
+
+/* step 0 hashes the message with a single update */
+static void check_kat(int i, HASHSUM hash, const char *expected, size_t step) {
+    hw_hash_kat_t *kat = &hw_hash_kat_tests[i];
+    size_t length;
+    unsigned char *message = kat_message(kat, &length);
+    hw_hash_ctx ctx;
+    unsigned char digest[HASHSUM_MAX_LENGTH];
+    char hex[2*HASHSUM_MAX_LENGTH+1];
+
+    hw_hash_init(&ctx, hash);
+    if (step) {
+        for (size_t offset = 0 ; offset < length ; offset += step) {
+            hw_hash_update(&ctx, &message[offset], length - offset < step ? length - offset : step);
+        }
+    } else {
+        hw_hash_update(&ctx, message, length);
+    }
+    hw_hash_final(&ctx, hash, digest);
+    to_hex(digest, hashsums[hash].length, hex);
+    ck_assert_msg(strcmp(expected, hex) == 0, "%s of '%s' x %zu (step %zu): %s != %s", attributes[hashsums[hash].attribute].db_name, kat->message, kat->repeat, step, hex, expected);
+    free(message);
+}
+
+START_TEST (test_hw_hash_sha1) {
+    if (!(hw_hash_attrs()&ATTR(attr_sha1))) {
+        return;
+    }
+    check_kat(_i, hash_sha1, hw_hash_kat_tests[_i].sha1, 0);
+    check_kat(_i, hash_sha1, hw_hash_kat_tests[_i].sha1, 1);
+    check_kat(_i, hash_sha1, hw_hash_kat_tests[_i].sha1, 97);
+}
+END_TEST
+
+START_TEST (test_hw_hash_sha256) {
+    if (!(hw_hash_attrs()&ATTR(attr_sha256))) {
+        return;
+    }
+    check_kat(_i, hash_sha256, hw_hash_kat_tests[_i].sha256, 0);
+    check_kat(_i, hash_sha256, hw_hash_kat_tests[_i].sha256, 1);
+    check_kat(_i, hash_sha256, hw_hash_kat_tests[_i].sha256, 97);
+}
+END_TEST
+
+/* _i is the number of messages in the batch */
+START_TEST (test_hw_hash_sha256_multi) {
+    int lanes = hw_hash_multi_lanes();
+    if (_i > lanes) {
+        return;
+    }
+    const unsigned char *data[HW_HASH_MAX_LANES];
+    size_t length[HW_HASH_MAX_LANES];
+    unsigned char digest[HW_HASH_MAX_LANES][32];
+    char hex[65];
+
+    /* spread the batch over the messages, starting with the longest one */
+    int index[HW_HASH_MAX_LANES];
+    for (int i = 0 ; i < _i ; ++i) {
+        index[i] = HW_HASH_MAX_LANES - 1 - i * HW_HASH_MAX_LANES / _i;
+        hw_hash_multi_t *m = &hw_hash_multi_tests[index[i]];
+        unsigned char *message = malloc(m->length + 1);
+        for (size_t j = 0 ; j < m->length ; ++j) {
+            message[j] = (index[i] + j) % 251;
+        }
+        data[i] = message;
+        length[i] = m->length;
+    }
+    hw_hash_sha256_multi(data, length, _i, digest);
+    for (int i = 0 ; i < _i ; ++i) {
+        const char *expected = hw_hash_multi_tests[index[i]].sha256;
+        to_hex(digest[i], 32, hex);
+        ck_assert_msg(strcmp(expected, hex) == 0, "sha256 of message %d (%zu bytes) in batch of %d: %s != %s", index[i], length[i], _i, hex, expected);
+        free((void *) data[i]);
+    }
+}
+END_TEST
+
+Suite *make_hw_hash_suite(void) {
+
+    Suite *s = suite_create ("hw_hash");
+
+    TCase *tc_kat = tcase_create ("known_answer");
+    TCase *tc_multi = tcase_create ("multi_buffer");
+
+    tcase_add_loop_test (tc_kat, test_hw_hash_sha1, 0, num_hw_hash_kat_tests);
+    tcase_add_loop_test (tc_kat, test_hw_hash_sha256, 0, num_hw_hash_kat_tests);
+    tcase_add_loop_test (tc_multi, test_hw_hash_sha256_multi, 1, HW_HASH_MAX_LANES + 1);
+
+    suite_add_tcase (s, tc_kat);
+    suite_add_tcase (s, tc_multi);
+
+    return s;
+}